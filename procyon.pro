@@ -46,15 +46,32 @@ SOURCES += src/main.cpp\
     src/spellcheck/LangCodeAndNames.cpp \
     src/MainWindow.cpp \
     src/CatalogWidget.cpp \
+    src/spellcheck/SpellcheckBlockData.cpp \
+    src/spellcheck/SpellcheckEngine.cpp \
     src/spellcheck/Spellchecker.cpp \
     src/TextEditHelpers.cpp \
     src/Utils.cpp \
     src/catalog/Catalog.cpp \
+    src/catalog/CatalogBenchmark.cpp \
+    src/catalog/CatalogLoader.cpp \
+    src/catalog/CatalogStats.cpp \
     src/catalog/CatalogStore.cpp \
+    src/catalog/ChunkStore.cpp \
     src/catalog/FolderManager.cpp \
+    src/catalog/HistoryManager.cpp \
+    src/catalog/MemoCache.cpp \
+    src/catalog/MemoCompressor.cpp \
     src/catalog/MemoManager.cpp \
+    src/catalog/MemoPrefetcher.cpp \
+    src/catalog/MemoWriter.cpp \
+    src/catalog/RecoveryJournal.cpp \
+    src/catalog/SearchIndexer.cpp \
+    src/catalog/SearchManager.cpp \
     src/catalog/SettingsManager.cpp \
     src/catalog/SqlHelper.cpp \
+    src/catalog/StoreBenchmark.cpp \
+    src/catalog/StoreWorker.cpp \
+    src/catalog/TextDelta.cpp \
     src/markdown/MarkdownHelper.cpp \
     src/editors/MarkdownMemoEditor.cpp \
     src/editors/MemoEditor.cpp \
@@ -71,8 +88,10 @@ SOURCES += src/main.cpp\
     src/OpenedPagesWidget.cpp \
     src/pages/HelpPage.cpp \
     src/pages/MarkdownCssEditorPage.cpp \
+    src/pages/MemoHistoryPanel.cpp \
     src/pages/MemoPage.cpp \
     src/pages/PageWidgets.cpp \
+    src/pages/SearchPage.cpp \
     src/pages/SqlConsolePage.cpp \
     src/pages/StyleEditorPage.cpp \
     src/spellcheck/TextEditSpellcheck.cpp
@@ -82,15 +101,32 @@ HEADERS  += src/MainWindow.h \
     src/CatalogWidget.h \
     src/CatalogModel.h \
     src/pages/AppSettingsPage.h \
+    src/spellcheck/SpellcheckBlockData.h \
+    src/spellcheck/SpellcheckEngine.h \
     src/spellcheck/Spellchecker.h \
     src/TextEditHelpers.h \
     src/Utils.h \
     src/catalog/Catalog.h \
+    src/catalog/CatalogBenchmark.h \
+    src/catalog/CatalogLoader.h \
+    src/catalog/CatalogStats.h \
     src/catalog/CatalogStore.h \
+    src/catalog/ChunkStore.h \
     src/catalog/FolderManager.h \
+    src/catalog/HistoryManager.h \
+    src/catalog/MemoCache.h \
+    src/catalog/MemoCompressor.h \
     src/catalog/MemoManager.h \
+    src/catalog/MemoPrefetcher.h \
+    src/catalog/MemoWriter.h \
+    src/catalog/RecoveryJournal.h \
+    src/catalog/SearchIndexer.h \
+    src/catalog/SearchManager.h \
     src/catalog/SettingsManager.h \
     src/catalog/SqlHelper.h \
+    src/catalog/StoreBenchmark.h \
+    src/catalog/StoreWorker.h \
+    src/catalog/TextDelta.h \
     src/markdown/MarkdownHelper.h \
     src/editors/MarkdownMemoEditor.h \
     src/editors/MemoEditor.h \
@@ -106,8 +142,10 @@ HEADERS  += src/MainWindow.h \
     src/OpenedPagesWidget.h \
     src/pages/HelpPage.h \
     src/pages/MarkdownCssEditorPage.h \
+    src/pages/MemoHistoryPanel.h \
     src/pages/MemoPage.h \
     src/pages/PageWidgets.h \
+    src/pages/SearchPage.h \
     src/pages/SqlConsolePage.h \
     src/pages/StyleEditorPage.h \
     src/spellcheck/TextEditSpellcheck.h
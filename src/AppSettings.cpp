@@ -122,6 +122,33 @@ AppSettings::Options AppSettings::options()
                     false,
                     &memoWordWrap
                     ),
+        new OptionSpec<bool>(
+                    "Notebook",
+                    "lazyLoading",
+                    "Load notebook tree lazily",
+                    "Load folder content only when the folder is expanded, "
+                    "it makes opening of very large notebooks faster",
+                    false,
+                    &lazyCatalogLoading
+                    ),
+        new OptionSpec<QString>(
+                    "Notebook",
+                    "storeProfile",
+                    "Storage profile",
+                    "\"fast\" uses write-ahead log and less disk syncs, it is for notebooks on local drives; "
+                    "\"safe\" uses rollback journal and full syncs, use it for notebooks on network shares",
+                    QStringLiteral("safe"),
+                    &storeProfile
+                    ),
+        new OptionSpec<int>(
+                    "Notebook",
+                    "memoCacheSize",
+                    "Memo cache size, MB",
+                    "Texts of recently used memos are kept in memory within this size, "
+                    "texts of memos not used for a long time are reloaded from the notebook when opened",
+                    64,
+                    &memoCacheSizeMb
+                    ),
         new OptionSpec<bool>(
                     "View",
                     "useNativeMenuBar",
@@ -67,6 +67,10 @@ public:
     QFont memoFont; ///< Default font used to desplay memo content.
     bool memoWordWrap; ///< Whether memo texts should be wrapped by default.
 
+    bool lazyCatalogLoading; ///< Load folder content only when the folder is expanded.
+    QString storeProfile; ///< Durability profile of notebook database: "fast" or "safe".
+    int memoCacheSizeMb; ///< Memory budget for texts of recently used memos.
+
     QString markdownCss();
     void updateMarkdownCss(const QString css);
 
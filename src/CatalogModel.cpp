@@ -2,6 +2,8 @@
 
 #include "catalog/Catalog.h"
 
+#include <QLocale>
+
 CatalogModel::CatalogModel(Catalog* catalog) : _catalog(catalog)
 {
     _iconMemo = QIcon(":/icon/memo_plain_text");
@@ -13,19 +15,12 @@ CatalogItem* CatalogModel::catalogItem(const QModelIndex &index)
     return static_cast<CatalogItem*>(index.internalPointer());
 }
 
-QModelIndex CatalogModel::findIndex(CatalogItem* item, const QModelIndex &parent)
+/// Items know their rows, so the index is made directly without searching through the tree.
+QModelIndex CatalogModel::findIndex(CatalogItem* item) const
 {
-    int rows = rowCount(parent);
-    for (int row = 0; row < rows; row++)
-    {
-        auto currentIndex = index(row, 0, parent);
-        auto currentItem = catalogItem(currentIndex);
-        if (currentItem == item) return currentIndex;
+    if (!item || item->row() < 0) return QModelIndex();
 
-        auto targetIndex = findIndex(item, currentIndex);
-        if (targetIndex.isValid()) return targetIndex;
-    }
-    return QModelIndex();
+    return createIndex(item->row(), 0, item);
 }
 
 QModelIndex CatalogModel::index(int row, int column, const QModelIndex &parent) const
@@ -59,11 +54,7 @@ QModelIndex CatalogModel::parent(const QModelIndex &child) const
     auto parentItem = childItem->parent();
     if (!parentItem) return QModelIndex();
 
-    int row = parentItem->parent()
-            ? parentItem->parent()->asFolder()->children().indexOf(parentItem)
-            : _catalog->items().indexOf(parentItem);
-
-    return createIndex(row, 0, parentItem);
+    return createIndex(parentItem->row(), 0, parentItem);
 }
 
 int CatalogModel::rowCount(const QModelIndex &parent) const
@@ -75,6 +66,53 @@ int CatalogModel::rowCount(const QModelIndex &parent) const
     return item && item->isFolder() ? item->asFolder()->children().size() : 0;
 }
 
+bool CatalogModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return !_catalog->items().isEmpty();
+
+    auto item = catalogItem(parent);
+    if (!item || !item->isFolder()) return false;
+
+    // Content of not populated folder is unknown, assume there is something
+    // to show the expand arrow, the folder will be populated on expanding.
+    auto folder = item->asFolder();
+    return !folder->isPopulated() || !folder->children().isEmpty();
+}
+
+bool CatalogModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) return false;
+
+    auto item = catalogItem(parent);
+    return item && item->isFolder() && !item->asFolder()->isPopulated();
+}
+
+void CatalogModel::fetchMore(const QModelIndex &parent)
+{
+    if (!parent.isValid()) return;
+
+    auto item = catalogItem(parent);
+    if (!item || !item->isFolder()) return;
+
+    auto folder = item->asFolder();
+    auto content = _catalog->selectChildren(folder);
+    if (!content.error.isEmpty())
+    {
+        qWarning() << "Unable to load content of folder" << item->id() << content.error;
+        return;
+    }
+
+    // Not populated folder has no children yet, so new rows start from the beginning.
+    // Items must appear in the folder only between begin and end of inserting.
+    int count = content.size();
+    if (count > 0)
+        beginInsertRows(parent, 0, count - 1);
+    _catalog->attachChildren(folder, content);
+    if (count > 0)
+        endInsertRows();
+}
+
 int CatalogModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
@@ -104,6 +142,17 @@ QVariant CatalogModel::data(const QModelIndex &index, int role) const
         if (item->isMemo())
             return item->asMemo()->type()->icon();
         return _iconMemo;
+
+    case Qt::ToolTipRole:
+        if (item->isFolder())
+        {
+            // Statistics are kept in memory, so it's cheap to show them on each hover
+            auto& stats = _catalog->stats();
+            return tr("%1\nMemos: %2\nCharacters: %3").arg(item->title())
+                    .arg(stats.memoCount(item->id()))
+                    .arg(QLocale().toString(stats.dataSize(item->id())));
+        }
+        return item->title();
     }
     return QVariant();
 }
@@ -126,6 +175,24 @@ QModelIndex CatalogModel::itemAdded(const QModelIndex &parent)
     return index(row, 0, parent);
 }
 
+// Memos loaded in background are appended after existing children of each folder,
+// so only the new rows are announced and views don't have to relayout the whole tree.
+void CatalogModel::itemsAboutToBeLoaded(FolderItem* folder, int firstRow, int lastRow)
+{
+    beginInsertRows(findIndex(folder), firstRow, lastRow);
+}
+
+void CatalogModel::itemsLoaded()
+{
+    endInsertRows();
+}
+
+void CatalogModel::itemsReset()
+{
+    beginResetModel();
+    endResetModel();
+}
+
 //------------------------------------------------------------------------------
 //                               ItemRemoverGuard
 //------------------------------------------------------------------------------
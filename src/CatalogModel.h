@@ -7,6 +7,7 @@
 
 class Catalog;
 class CatalogItem;
+class FolderItem;
 
 class CatalogModel : public QAbstractItemModel
 {
@@ -15,16 +16,22 @@ public:
 
     static CatalogItem* catalogItem(const QModelIndex &index);
 
-    QModelIndex findIndex(CatalogItem* item, const QModelIndex &parent = QModelIndex());
+    QModelIndex findIndex(CatalogItem* item) const;
 
     QModelIndex index(int row, int column, const QModelIndex &parent) const override;
     QModelIndex parent(const QModelIndex &child) const override;
     int rowCount(const QModelIndex &parent) const override;
+    bool hasChildren(const QModelIndex &parent) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
     int columnCount(const QModelIndex &parent) const override;
     QVariant data(const QModelIndex &index, int role) const override;
 
     void itemRenamed(const QModelIndex &index);
     QModelIndex itemAdded(const QModelIndex &parent);
+    void itemsAboutToBeLoaded(FolderItem* folder, int firstRow, int lastRow);
+    void itemsLoaded();
+    void itemsReset();
 
     friend class ItemRemoverGuard;
 
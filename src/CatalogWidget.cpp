@@ -13,6 +13,13 @@
 #include <QTreeView>
 #include <QWidgetAction>
 
+namespace {
+
+// How many memos before and after the selected one are prefetched
+const int PREFETCH_SIBLINGS = 10;
+
+} // namespace
+
 struct CatalogSelection
 {
     QModelIndex index;
@@ -117,7 +124,7 @@ CatalogWidget::CatalogWidget() : QWidget()
 void CatalogWidget::setCatalog(Catalog* catalog)
 {
     if (_catalog)
-        disconnect(_catalog, &Catalog::memoUpdated, this, &CatalogWidget::memoUpdated);
+        disconnect(_catalog, nullptr, this, nullptr);
 
     _catalog = catalog;
     if (_catalogModel)
@@ -129,8 +136,16 @@ void CatalogWidget::setCatalog(Catalog* catalog)
     {
         _catalogModel = new CatalogModel(_catalog);
         connect(_catalog, &Catalog::memoUpdated, this, &CatalogWidget::memoUpdated);
+        connect(_catalog, &Catalog::batchCommitted, this, &CatalogWidget::batchCommitted);
+        connect(_catalog, &Catalog::memosAboutToBeLoaded, this, [this](FolderItem* folder, int firstRow, int lastRow){
+            _catalogModel->itemsAboutToBeLoaded(folder, firstRow, lastRow);
+        });
+        connect(_catalog, &Catalog::memosLoaded, this, [this]{ _catalogModel->itemsLoaded(); });
     }
     _catalogView->setModel(_catalogModel);
+    if (_catalogModel)
+        connect(_catalogView->selectionModel(), &QItemSelectionModel::currentChanged,
+                this, &CatalogWidget::currentChanged);
 }
 
 void CatalogWidget::contextMenuRequested(const QPoint &pos)
@@ -170,6 +185,21 @@ void CatalogWidget::doubleClicked(const QModelIndex&)
     openSelectedMemo();
 }
 
+void CatalogWidget::currentChanged(const QModelIndex& current)
+{
+    auto item = CatalogModel::catalogItem(current);
+    if (!item || !item->isMemo()) return;
+
+    // Neighbouring memos are likely to be opened next when user walks through a folder
+    const auto& siblings = item->parent() ? item->parent()->asFolder()->children() : _catalog->items();
+    int index = item->row();
+    QList<MemoItem*> memos;
+    for (int i = qMax(0, index - PREFETCH_SIBLINGS); i <= qMin(siblings.size() - 1, index + PREFETCH_SIBLINGS); i++)
+        if (siblings.at(i)->isMemo())
+            memos << siblings.at(i)->asMemo();
+    _catalog->prefetchMemos(memos);
+}
+
 SelectedItems CatalogWidget::selection() const
 {
     CatalogSelection selected(_catalogView);
@@ -192,11 +222,20 @@ void CatalogWidget::createTopLevelFolder()
     createFolderInternal(CatalogSelection());
 }
 
+void CatalogWidget::fetchFolder(const QModelIndex& index)
+{
+    if (_catalogModel->canFetchMore(index))
+        _catalogModel->fetchMore(index);
+}
+
 void CatalogWidget::createFolderInternal(const CatalogSelection& selection)
 {
     auto title = Ori::Dlg::inputText(tr("Enter a title for new folder"), "");
     if (title.isEmpty()) return;
 
+    // New item is added to the end of folder content, so it should be loaded before
+    fetchFolder(selection.index);
+
     auto res = _catalog->createFolder(selection.folder, title);
     if (!res.ok()) return Ori::Dlg::error(res.error());
 
@@ -280,6 +319,8 @@ void CatalogWidget::createMemo()
     auto memoType = selectMemoTypeDlg();
     if (!memoType) return;
 
+    fetchFolder(selection.index);
+
     auto memoItem = new MemoItem;
     auto res = _catalog->createMemo(selection.folder, memoItem, memoType);
     if (!res.ok())
@@ -319,6 +360,15 @@ void CatalogWidget::memoUpdated(MemoItem* item)
         _catalogModel->itemRenamed(index);
 }
 
+void CatalogWidget::batchCommitted()
+{
+    // A batch can add and remove lots of items in different folders,
+    // it's simpler to rebuild the view than to notify about each of them.
+    auto expandedIds = getExpandedIds();
+    _catalogModel->itemsReset();
+    setExpandedIds(expandedIds);
+}
+
 QStringList CatalogWidget::getExpandedIds() const
 {
     QStringList ids;
@@ -355,7 +405,12 @@ void CatalogWidget::setExpandedIds(const QStringList& ids, const QModelIndex& pa
         auto data = _catalogModel->data(index, Qt::UserRole);
         if (data.isNull()) continue;
         if (ids.contains(QString::number(data.toInt())))
+        {
+            // View can postpone fetching of folder content until the next layout,
+            // but we need it right now to get into expanded subfolders.
+            fetchFolder(index);
             _catalogView->expand(index);
+        }
         setExpandedIds(ids, index);
     }
 }
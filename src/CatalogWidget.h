@@ -56,10 +56,13 @@ private:
 
     void contextMenuRequested(const QPoint &pos);
     void doubleClicked(const QModelIndex &);
+    void currentChanged(const QModelIndex& current);
     void openSelectedMemo();
 
     void memoUpdated(MemoItem*);
+    void batchCommitted();
     void createFolderInternal(const CatalogSelection& selection);
+    void fetchFolder(const QModelIndex& index);
 
     void fillExpandedIds(QStringList& ids, const QModelIndex& parentIndex) const;
     void setExpandedIds(const QStringList& ids, const QModelIndex& parentIndex);
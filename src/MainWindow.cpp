@@ -4,12 +4,18 @@
 #include "CatalogWidget.h"
 #include "OpenedPagesWidget.h"
 #include "catalog/Catalog.h"
+#include "catalog/CatalogBenchmark.h"
+#include "catalog/CatalogLoader.h"
 #include "catalog/CatalogStore.h"
+#include "catalog/ChunkStore.h"
+#include "catalog/RecoveryJournal.h"
+#include "catalog/StoreBenchmark.h"
 #include "highlighter/HighlighterControl.h"
 #include "pages/AppSettingsPage.h"
 #include "pages/HelpPage.h"
 #include "pages/MarkdownCssEditorPage.h"
 #include "pages/MemoPage.h"
+#include "pages/SearchPage.h"
 #include "pages/SqlConsolePage.h"
 #include "pages/StyleEditorPage.h"
 #include "spellcheck/Spellchecker.h"
@@ -29,7 +35,9 @@
 #include <QFrame>
 #include <QIcon>
 #include <QLabel>
+#include <QLocale>
 #include <QMenuBar>
+#include <QProgressBar>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QStackedWidget>
@@ -152,6 +160,8 @@ void MainWindow::createMenu()
     _actionOpenMemo = m->addAction(tr("Open Memo"), this, &MainWindow::openMemo);
     _actionCreateMemo = m->addAction(tr("New Memo..."), [this](){ _catalogView->createMemo(); });
     _actionDeleteMemo = m->addAction(tr("Delete Memo"), [this](){ _catalogView->deleteMemo(); });
+    m->addSeparator();
+    _actionSearch = m->addAction(tr("Search..."), this, &MainWindow::openSearchPage, QKeySequence::Find);
 
     m = menuBar()->addMenu(tr("Memo"));
     connect(m, &QMenu::aboutToShow, this, &MainWindow::optionsMenuAboutToShow);
@@ -190,6 +200,16 @@ void MainWindow::createMenu()
         m->addAction(tr("Open SQL Console"), this, [this]{
             openNewPage<SqlConsolePage>(_pagesView, _openedPagesView);
         });
+        m->addAction(tr("Benchmark Storage Profiles"), this, []{
+            Ori::WaitCursor c;
+            Ori::Dlg::info(StoreBenchmark::run());
+        });
+        m->addAction(tr("Benchmark Catalog"), this, []{
+            Ori::WaitCursor c;
+            Ori::Dlg::info(CatalogBenchmark::run());
+        });
+        m->addAction(tr("Deduplication Report"), this, &MainWindow::showDedupReport);
+        m->addAction(tr("Spellcheck Cache Report"), this, &MainWindow::showSpellcheckCacheReport);
     }
 
     m = menuBar()->addMenu(tr("Help"));
@@ -227,6 +247,18 @@ void MainWindow::createStatusBar()
 {
     statusBar()->addWidget(makeStatusPanel(tr("Memos:"), _statusMemoCount));
     statusBar()->addWidget(makeStatusPanel(tr("Notebook:"), _statusFileName));
+
+    _statusProgress = new QProgressBar;
+    _statusProgress->setMaximumWidth(150);
+    _statusProgress->setTextVisible(false);
+    _statusProgress->setVisible(false);
+    statusBar()->addPermanentWidget(_statusProgress);
+
+    if (AppSettings::instance().isDevMode)
+    {
+        _statusMemoCache = new QLabel;
+        statusBar()->addPermanentWidget(_statusMemoCache);
+    }
 }
 
 void MainWindow::saveSettings(QSettings* s)
@@ -276,13 +308,21 @@ void MainWindow::loadSession()
     _catalogView->setExpandedIds(expandedIds);
 
     QStringList openedIds = settings.value("openedMemos").toString().split(',');
+    QList<MemoItem*> openedItems;
     for (auto idStr : openedIds)
     {
         auto memoItem = _catalog->findMemoById(idStr.toInt());
-        if (!memoItem) continue;
-        openMemoPage(memoItem);
+        if (memoItem) openedItems << memoItem;
     }
 
+    // Pages are opened right now so texts are read at once instead of prefetching them in background
+    auto res = _catalog->loadMemos(openedItems);
+    if (!res.isEmpty())
+        qWarning() << "Unable to load session memos, they will be loaded one by one" << res;
+
+    for (auto memoItem : openedItems)
+        openMemoPage(memoItem);
+
     int activeId = settings.value("activeMemo", -1).toInt();
     auto activeMemoItem = _catalog->findMemoById(activeId);
     if (activeMemoItem) openMemoPage(activeMemoItem);
@@ -328,9 +368,13 @@ void MainWindow::newCatalog()
 
     if (!closeCatalog()) return;
 
+    CatalogStore::setStoreConfig(CatalogStore::StoreConfig::profile(AppSettings::instance().storeProfile));
     auto res = Catalog::create(fileName);
     if (res.ok())
+    {
         catalogOpened(res.result());
+        updateCounter();
+    }
     else Ori::Dlg::error(tr("Unable to create notebook.\n\n%1").arg(res.error()));
 }
 
@@ -341,12 +385,22 @@ void MainWindow::openCatalog(const QString &fileName)
     if (_catalog && QFileInfo(_catalog->fileName()) == QFileInfo(fileName))
         return;
 
+    if (_catalogLoader && QFileInfo(_catalogLoader->fileName()) == QFileInfo(fileName))
+        return;
+
     if (!closeCatalog()) return;
 
-    auto res = Catalog::open(fileName);
-    if (res.ok())
-        catalogOpened(res.result());
-    else Ori::Dlg::error(tr("Unable to load notebook.\n\n%1").arg(res.error()));
+    // The catalog is shown as soon as its folders are loaded,
+    // memos are added while the user can already work with the tree.
+    CatalogStore::setStoreConfig(CatalogStore::StoreConfig::profile(AppSettings::instance().storeProfile));
+    _catalogLoader = new CatalogLoader(fileName, AppSettings::instance().lazyCatalogLoading, this);
+    connect(_catalogLoader, &CatalogLoader::opened, this, &MainWindow::catalogOpened);
+    connect(_catalogLoader, &CatalogLoader::progress, this, &MainWindow::catalogLoadingProgress);
+    connect(_catalogLoader, &CatalogLoader::finished, this, &MainWindow::catalogLoaded);
+    _statusProgress->setRange(0, 0);
+    _statusProgress->setVisible(true);
+    _statusFileName->setText(QDir::toNativeSeparators(fileName));
+    _catalogLoader->start();
 }
 
 void MainWindow::openCatalogViaDialog()
@@ -360,8 +414,11 @@ void MainWindow::openCatalogViaDialog()
 void MainWindow::catalogOpened(Catalog* catalog)
 {
     _catalog = catalog;
+    _catalog->memoCache().setBudget(qint64(AppSettings::instance().memoCacheSizeMb) * 1024 * 1024);
     connect(_catalog, &Catalog::memoCreated, this, &MainWindow::memoCreated);
     connect(_catalog, &Catalog::memoRemoved, this, &MainWindow::memoRemoved);
+    connect(_catalog, &Catalog::memoSaveFailed, this, &MainWindow::memoSaveFailed);
+    connect(_catalog, &Catalog::batchCommitted, this, &MainWindow::memosBatchCommitted);
     _catalogView->setCatalog(_catalog);
     auto filePath = _catalog->fileName();
     auto fileName = QFileInfo(filePath).fileName();
@@ -369,23 +426,133 @@ void MainWindow::catalogOpened(Catalog* catalog)
     _mruList->append(filePath);
     _statusFileName->setText(QDir::toNativeSeparators(filePath));
     _lastOpenedCatalog = filePath;
+    updateMemoCacheStatus();
+}
+
+void MainWindow::updateMemoCacheStatus()
+{
+    if (!_statusMemoCache) return;
+
+    if (!_catalog)
+    {
+        _statusMemoCache->clear();
+        return;
+    }
+
+    auto& stats = _catalog->memoCache().stats();
+    _statusMemoCache->setText(tr("Cache: %1 hits, %2 misses, %3 evicted, %4 memos, %5 MB")
+        .arg(stats.hits).arg(stats.misses).arg(stats.evictions).arg(stats.count)
+        .arg(double(stats.bytes) / 1024.0 / 1024.0, 0, 'f', 1));
+}
+
+void MainWindow::showDedupReport()
+{
+    if (!_catalog) return;
+
+    ChunkStore::Stats stats;
+    auto res = ChunkStore::selectStats(&stats);
+    if (!res.isEmpty()) return Ori::Dlg::error(res);
+
+    // Search index built by older SQLite keeps its own plain copy of texts, it eats the savings
+    qint64 indexCopyBytes = 0;
+    res = CatalogStore::searchManager()->selectContentSize(&indexCopyBytes);
+    if (!res.isEmpty()) return Ori::Dlg::error(res);
+
+    auto kb = [](qint64 bytes) { return QString::number(double(bytes) / 1024.0, 'f', 1); };
+    qint64 saved = stats.referencedBytes - stats.storedBytes;
+    QString report = tr("Memos stored in chunks: %1 chunks referenced %2 times\n\n"
+                        "Stored: %3 KB\nWithout deduplication: %4 KB\nSaved: %5 KB")
+        .arg(stats.chunkCount).arg(stats.refCount)
+        .arg(kb(stats.storedBytes), kb(stats.referencedBytes), kb(saved));
+    if (indexCopyBytes > 0)
+        report += tr("\n\nPlain copy of memo texts in search index: %1 KB").arg(kb(indexCopyBytes));
+    Ori::Dlg::info(report);
+}
+
+void MainWindow::showSpellcheckCacheReport()
+{
+    auto spellcheckers = Spellchecker::loaded();
+    if (spellcheckers.isEmpty())
+        return Ori::Dlg::info(tr("No dictionaries have been used yet"));
+
+    QStringList report;
+    for (auto spellchecker : spellcheckers)
+    {
+        auto stats = spellchecker->cacheStats();
+        qint64 total = stats.hits + stats.misses;
+        double hitRate = total > 0 ? 100.0 * double(stats.hits) / double(total) : 0;
+        report << tr("%1: %2 words cached, %3 hits, %4 misses, hit rate %5%")
+            .arg(spellchecker->lang()).arg(stats.size).arg(stats.hits).arg(stats.misses)
+            .arg(hitRate, 0, 'f', 1);
+    }
+    Ori::Dlg::info(report.join("\n\n"));
+}
+
+void MainWindow::catalogLoadingProgress(int loaded, int total)
+{
+    _statusProgress->setRange(0, total);
+    _statusProgress->setValue(loaded);
+    _statusMemoCount->setText(QString::number(loaded));
+}
+
+void MainWindow::catalogLoaded(const QString& error)
+{
+    _catalogLoader->deleteLater();
+    _catalogLoader = nullptr;
+    _statusProgress->setVisible(false);
+
+    if (!_catalog)
+    {
+        _statusFileName->setText(tr("(n/a)"));
+        Ori::Dlg::error(tr("Unable to load notebook.\n\n%1").arg(error));
+        return;
+    }
+
     updateCounter();
+
+    if (!error.isEmpty())
+    {
+        // Don't restore the session, it could refer to memos that are not loaded
+        Ori::Dlg::error(tr("Notebook is loaded partially.\n\n%1").arg(error));
+        return;
+    }
+
     loadSession();
+    recoverMemos();
+
+    _catalog->startCompression();
+    _catalog->startIndexing();
 }
 
 bool MainWindow::closeCatalog()
 {
     if (_catalog)
     {
-        saveSession();
+        // The session is not restored until loading is finished, saving it would lose the previous one
+        if (!_catalogLoader)
+            saveSession();
         if (!closeAllMemos()) return false;
+    }
+    if (_catalogLoader)
+    {
+        // Loader is cancelled in destructor
+        delete _catalogLoader;
+        _catalogLoader = nullptr;
+        _statusProgress->setVisible(false);
+    }
+    if (_catalog)
+    {
+        for (auto page : getPages<SearchPage>(_pagesView))
+            page->deleteLater();
         _catalogView->setCatalog(nullptr);
         delete _catalog;
         _catalog = nullptr;
+        CatalogStore::closeDatabase();
     }
     setWindowTitle(qApp->applicationName());
     _statusFileName->setText(tr("(n/a)"));
     _statusMemoCount->setText(tr("(none)"));
+    updateMemoCacheStatus();
    return true;
 }
 
@@ -408,17 +575,25 @@ bool MainWindow::closeAllMemos()
 
 void MainWindow::updateCounter()
 {
-    auto res = _catalog->countMemos();
-    if (res.ok())
+    if (!_catalog->statsError().isEmpty())
     {
-        _statusMemoCount->setToolTip(QString());
-        _statusMemoCount->setText(QString::number(res.result()));
+        _statusMemoCount->setToolTip(_catalog->statsError());
+        _statusMemoCount->setText(tr("ERROR"));
+        return;
     }
-    else
+
+    auto& stats = _catalog->stats();
+    QStringList hint;
+    hint << tr("Characters in memos: %1").arg(QLocale().toString(stats.dataSize()));
+    auto types = stats.typeCounts();
+    for (auto it = types.constBegin(); it != types.constEnd(); it++)
     {
-        _statusMemoCount->setToolTip(res.error());
-        _statusMemoCount->setText(tr("ERROR"));
+        auto memoType = memoTypes().value(it.key());
+        QString typeTitle = memoType ? qApp->translate("MemoType", memoType->title()) : it.key();
+        hint << QString("%1: %2").arg(typeTitle).arg(it.value());
     }
+    _statusMemoCount->setToolTip(hint.join('\n'));
+    _statusMemoCount->setText(QString::number(stats.memoCount()));
 }
 
 void MainWindow::updateMenuCatalog()
@@ -439,6 +614,7 @@ void MainWindow::updateMenuCatalog()
     _actionOpenMemo->setEnabled(hasMemo);
     _actionDeleteMemo->setEnabled(hasMemo);
     _actionCreateMemo->setEnabled(hasFolder);
+    _actionSearch->setEnabled(hasCatalog);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -459,11 +635,10 @@ void MainWindow::openMemo()
 
 void MainWindow::openMemoPage(MemoItem* item)
 {
-    if (!item->isLoaded())
-    {
-        auto res = _catalog->loadMemo(item);
-        if (!res.isEmpty()) return Ori::Dlg::error(res);
-    }
+    // Memo text can be unloaded by the memo cache even if it was loaded before
+    auto res = _catalog->loadMemo(item);
+    updateMemoCacheStatus();
+    if (!res.isEmpty()) return Ori::Dlg::error(res);
 
     auto existedPage = findMemoPage(item);
     if (existedPage)
@@ -485,6 +660,25 @@ void MainWindow::openMemoPage(MemoItem* item)
     page->loadSettings();
 }
 
+void MainWindow::openSearchPage()
+{
+    if (!_catalog) return;
+
+    auto pages = getPages<SearchPage>(_pagesView);
+    if (!pages.isEmpty())
+    {
+        _pagesView->setCurrentWidget(pages.first());
+        _openedPagesView->addOpenedPage(pages.first());
+        return;
+    }
+
+    auto page = new SearchPage(_catalog);
+    connect(page, &SearchPage::onOpenMemo, this, &MainWindow::openMemoPage);
+    _pagesView->addWidget(page);
+    _pagesView->setCurrentWidget(page);
+    _openedPagesView->addOpenedPage(page);
+}
+
 MemoPage* MainWindow::findMemoPage(MemoItem* item) const
 {
     for (int i = 0; i < _pagesView->count(); i++)
@@ -551,6 +745,69 @@ void MainWindow::memoRemoved(MemoItem* item)
     if (page) page->deleteLater();
 }
 
+void MainWindow::recoverMemos()
+{
+    auto journal = _catalog->recoveryJournal();
+    if (journal->recovered().isEmpty()) return;
+
+    QStringList titles;
+    for (auto& memo : journal->recovered())
+        titles << memo.title.toHtmlEscaped();
+
+    auto confirm = tr("The notebook was not closed properly last time. "
+                      "There are unsaved changes in memos:<br/><br/><b>%1</b><br/><br/>"
+                      "Restore them? Restored memos will be opened for editing.").arg(titles.join("<br/>"));
+    if (Ori::Dlg::yes(confirm))
+    {
+        QStringList errors;
+        for (auto& memo : journal->recovered())
+        {
+            // The memo could be deleted in another program instance or not loaded in lazy mode
+            auto item = _catalog->findMemoById(memo.memoId);
+            if (!item)
+            {
+                errors << tr("%1: memo not found").arg(memo.title);
+                continue;
+            }
+            openMemoPage(item);
+            auto page = findMemoPage(item);
+            if (!page) continue; // Unable to load memo, error is already shown
+
+            auto res = page->recoverEdit(memo);
+            if (!res.isEmpty())
+                errors << QString("%1: %2").arg(memo.title, res);
+        }
+        if (!errors.isEmpty())
+            Ori::Dlg::error(tr("Some changes can't be restored.\n\n%1").arg(errors.join('\n')));
+    }
+
+    // Recovered changes are either in opened editors now or rejected by user
+    journal->discardRecovered();
+}
+
+void MainWindow::memoSaveFailed(MemoItem* item, const QString& error)
+{
+    Ori::Dlg::error(tr("Unable to save memo '%1'.\n\n%2").arg(item->title(), error));
+
+    // The text is kept in memory, so it's possible to try saving again
+    openMemoPage(item);
+    auto page = findMemoPage(item);
+    if (page) page->restoreFailedEdit();
+}
+
+void MainWindow::memosBatchCommitted(const CatalogChanges& changes)
+{
+    updateCounter();
+
+    // Pages are not opened for created memos as it's done for a single memo,
+    // a batch is supposed to create them by hundreds.
+    for (auto item : changes.removedMemos)
+    {
+        auto page = findMemoPage(item);
+        if (page) page->deleteLater();
+    }
+}
+
 void MainWindow::optionsMenuAboutToShow()
 {
     if (!_spellcheckMenu) return;
@@ -6,12 +6,15 @@
 QT_BEGIN_NAMESPACE
 class QAction;
 class QLabel;
+class QProgressBar;
 class QStackedWidget;
 class QSplitter;
 class QSettings;
 QT_END_NAMESPACE
 
 class Catalog;
+struct CatalogChanges;
+class CatalogLoader;
 class CatalogWidget;
 class OpenedPagesWidget;
 class SpellcheckControl;
@@ -42,14 +45,17 @@ protected:
 private:
     QSplitter* _splitter;
     Catalog* _catalog = nullptr;
+    CatalogLoader* _catalogLoader = nullptr;
     CatalogWidget* _catalogView;
     QStackedWidget* _pagesView;
     OpenedPagesWidget* _openedPagesView;
     Ori::MruFileList *_mruList;
     QLabel *_statusMemoCount, *_statusFileName;
+    QProgressBar* _statusProgress;
+    QLabel* _statusMemoCache = nullptr;
     QAction *_actionCreateTopLevelFolder, *_actionCreateFolder, *_actionRenameFolder, *_actionDeleteFolder;
     QAction *_actionMemoFont, *_actionWordWrap, *_actionMemoExportPdf;
-    QAction *_actionOpenMemo, *_actionCreateMemo, *_actionDeleteMemo;
+    QAction *_actionOpenMemo, *_actionCreateMemo, *_actionDeleteMemo, *_actionSearch;
     QString _lastOpenedCatalog;
     SpellcheckControl* _spellcheckControl;
     HighlighterControl* _highlighterControl;
@@ -58,11 +64,17 @@ private:
     void createMenu();
     void createStatusBar();
     void loadSession();
+    void recoverMemos();
     void saveSession();
     void newCatalog();
     void openCatalog(const QString &fileName);
     void openCatalogViaDialog();
     void catalogOpened(Catalog* catalog);
+    void updateMemoCacheStatus();
+    void showDedupReport();
+    void showSpellcheckCacheReport();
+    void catalogLoadingProgress(int loaded, int total);
+    void catalogLoaded(const QString& error);
     bool closeCatalog();
     void updateCounter();
     void updateMenuCatalog();
@@ -71,8 +83,11 @@ private:
     void toggleWordWrap();
     void memoCreated(MemoItem* item);
     void memoRemoved(MemoItem* item);
+    void memoSaveFailed(MemoItem* item, const QString& error);
+    void memosBatchCommitted(const CatalogChanges& changes);
     bool closeAllMemos();
     void openMemoPage(MemoItem* item);
+    void openSearchPage();
     void exportToPdf();
     MemoPage* findMemoPage(MemoItem* item) const;
     MemoPage* currentMemoPage() const;
@@ -1,11 +1,26 @@
 #include "Catalog.h"
 #include "CatalogStore.h"
+#include "MemoCompressor.h"
+#include "MemoPrefetcher.h"
+#include "MemoWriter.h"
+#include "RecoveryJournal.h"
+#include "SearchIndexer.h"
 
 #include <QDebug>
+#include <QTimer>
 #include <QUuid>
 
 static const QString KEY_UID("UID");
 
+// Memos having greater ids can still be stored uncompressed
+static const QString KEY_COMPRESSED_UP_TO_ID("CompressedUpToId");
+
+// Changes of memo options are collected for a while and then written at once
+static const int MEMO_OPTIONS_FLUSH_DELAY_MS = 2000;
+
+// Changed settings are written shortly after, so a crash doesn't lose them
+static const int SETTINGS_FLUSH_DELAY_MS = 2000;
+
 //------------------------------------------------------------------------------
 //                                MemoType
 //------------------------------------------------------------------------------
@@ -41,10 +56,31 @@ MemoType* getMemoType(const QString& type)
 //------------------------------------------------------------------------------
 
 CatalogItem::~CatalogItem() {}
-bool CatalogItem::isFolder() const { return dynamic_cast<const FolderItem*>(this); }
-bool CatalogItem::isMemo() const { return dynamic_cast<const MemoItem*>(this); }
-FolderItem* CatalogItem::asFolder() { return dynamic_cast<FolderItem*>(this); }
-MemoItem* CatalogItem::asMemo() { return dynamic_cast<MemoItem*>(this); }
+
+/// Items must be added and removed only via these functions to keep their rows valid.
+void CatalogItem::appendTo(QList<CatalogItem*>& items, CatalogItem* item)
+{
+    item->_row = items.size();
+    items.append(item);
+}
+
+void CatalogItem::insertTo(QList<CatalogItem*>& items, CatalogItem* item, int row)
+{
+    items.insert(row, item);
+    for (int i = row; i < items.size(); i++)
+        items.at(i)->_row = i;
+}
+
+void CatalogItem::removeFrom(QList<CatalogItem*>& items, CatalogItem* item)
+{
+    int row = item->_row;
+    Q_ASSERT(row >= 0 && row < items.size() && items.at(row) == item);
+
+    items.removeAt(row);
+    for (int i = row; i < items.size(); i++)
+        items.at(i)->_row = i;
+    item->_row = -1;
+}
 
 const QString CatalogItem::path() const
 {
@@ -75,6 +111,15 @@ MemoItem::~MemoItem()
 {
 }
 
+//------------------------------------------------------------------------------
+//                               CatalogChanges
+//------------------------------------------------------------------------------
+
+bool CatalogChanges::isEmpty() const
+{
+    return createdMemos.isEmpty() && updatedMemos.isEmpty() && removedMemos.isEmpty() && !foldersChanged;
+}
+
 //------------------------------------------------------------------------------
 //                                   Catalog
 //------------------------------------------------------------------------------
@@ -89,7 +134,7 @@ QString Catalog::defaultFileExt()
     return QStringLiteral("enot");
 }
 
-CatalorResult Catalog::open(const QString& fileName)
+CatalorResult Catalog::open(const QString& fileName, bool lazy)
 {
     QString res = CatalogStore::openDatabase(fileName);
     if (!res.isEmpty())
@@ -97,6 +142,21 @@ CatalorResult Catalog::open(const QString& fileName)
 
     Catalog* catalog = new Catalog;
     catalog->_fileName = fileName;
+    catalog->_isLazy = lazy;
+    catalog->loadCaches();
+
+    // In lazy mode, only top level items are loaded here,
+    // the content of folders is loaded when they are expanded.
+    if (lazy)
+    {
+        auto topLevel = catalog->fetchChildren(nullptr);
+        if (!topLevel.ok())
+        {
+            delete catalog;
+            return CatalorResult::fail(topLevel.error());
+        }
+        return CatalorResult::ok(catalog);
+    }
 
     FoldersResult folders = CatalogStore::folderManager()->selectAll();
     if (!folders.error.isEmpty())
@@ -105,13 +165,7 @@ CatalorResult Catalog::open(const QString& fileName)
         return CatalorResult::fail(folders.error);
     }
 
-    for (FolderItem* item: folders.items.values())
-    {
-        catalog->_allFolders[item->id()] = item;
-
-        if (!item->parent())
-            catalog->_items.append(item);
-    }
+    catalog->attachFolders(folders);
 
     MemosResult memos = CatalogStore::memoManager()->selectAll();
     if (!memos.error.isEmpty())
@@ -120,36 +174,67 @@ CatalorResult Catalog::open(const QString& fileName)
         return CatalorResult::fail(memos.error);
     }
 
+    catalog->attachMemos(memos);
+
+    return CatalorResult::ok(catalog);
+}
+
+void Catalog::attachFolders(const FoldersResult& folders)
+{
+    for (FolderItem* item: folders.items.values())
+    {
+        _allFolders[item->id()] = item;
+
+        if (!item->parent())
+            CatalogItem::appendTo(_items, item);
+    }
+}
+
+/// Adds memos to already attached folders. When the catalog is loaded in background,
+/// this is called for each batch of memos, so views are notified about rows appended to each folder.
+void Catalog::attachMemos(const MemosResult& memos)
+{
     if (!memos.warnings.isEmpty())
         for (auto warning: memos.warnings)
             qWarning() << warning; // TODO make protocol window
 
     for (int folderId: memos.items.keys())
     {
+        FolderItem *parent = nullptr;
         if (folderId > 0)
         {
-            if (!folders.items.contains(folderId))
+            parent = _allFolders.value(folderId);
+            if (!parent)
             {
                 qWarning() << tr("Some memos are stored in folder #%1 but that "
                                  "is not found in the directory.").arg(folderId);
                 qDeleteAll(memos.items[folderId]);
                 continue;
             }
-            FolderItem *parent = folders.items[folderId];
-            for (MemoItem* item: memos.items[folderId])
-            {
-                item->_parent = parent;
-                parent->_children.append(item);
-            }
         }
-        else
-            for (MemoItem* item: memos.items[folderId])
-                catalog->_items.append(item);
-    }
 
-    catalog->_allMemos = memos.allMemos;
+        QList<MemoItem*> items;
+        for (MemoItem* item: memos.items[folderId])
+        {
+            // A memo created while the catalog is being loaded in background
+            // can be selected by the loader too, it already has its item.
+            if (_allMemos.contains(item->id()))
+                delete item;
+            else
+                items << item;
+        }
+        if (items.isEmpty()) continue;
 
-    return CatalorResult::ok(catalog);
+        auto& children = parent ? parent->_children : _items;
+        emit memosAboutToBeLoaded(parent, children.size(), children.size() + items.size() - 1);
+        for (MemoItem* item: items)
+        {
+            item->_parent = parent;
+            CatalogItem::appendTo(children, item);
+            _allMemos.insert(item->id(), item);
+        }
+        emit memosLoaded();
+    }
 }
 
 CatalorResult Catalog::create(const QString& fileName)
@@ -163,6 +248,7 @@ CatalorResult Catalog::create(const QString& fileName)
 
     Catalog* catalog = new Catalog;
     catalog->_fileName = fileName;
+    catalog->loadCaches();
 
     return CatalorResult::ok(catalog);
 }
@@ -173,6 +259,25 @@ Catalog::Catalog() : QObject()
 
 Catalog::~Catalog()
 {
+    // Wait until the current portions are processed
+    delete _compressor;
+    delete _searchIndexer;
+
+    // Waits until all memos are saved
+    delete _memoWriter;
+
+    QString res = flushMemoOptions();
+    if (!res.isEmpty())
+        qWarning() << "Failed to store memo options" << res;
+
+    if (_settingsTimer)
+        _settingsTimer->stop();
+
+    res = CatalogStore::settingsManager()->flush();
+    if (!res.isEmpty())
+        qWarning() << "Failed to store notebook settings" << res;
+
+    qDeleteAll(_batchDeletingItems);
     qDeleteAll(_items);
 }
 
@@ -181,14 +286,145 @@ QString Catalog::renameFolder(FolderItem* item, const QString& title)
     QString res = CatalogStore::folderManager()->rename(item->id(), title);
     if (!res.isEmpty()) return res;
 
+    if (_batchDepth > 0)
+    {
+        QString oldTitle = item->_title;
+        _batchUndo.append([item, oldTitle]{ item->_title = oldTitle; });
+        _batchFoldersChanged = true;
+    }
+
     item->_title = title;
 
     // TODO sort items after renaming
     return QString();
 }
 
+// Null parent means top level items, they are fetched once when catalog is opened.
+IntResult Catalog::fetchChildren(FolderItem* parent)
+{
+    if (parent && parent->isPopulated())
+        return IntResult::ok(0);
+
+    auto content = selectChildren(parent);
+    if (!content.error.isEmpty())
+        return IntResult::fail(content.error);
+
+    attachChildren(parent, content);
+    return IntResult::ok(content.size());
+}
+
+/// Reads children of a folder which is not populated yet. They are not added to the folder,
+/// so a model can announce new rows before the items appear in the catalog, see `attachChildren()`.
+FolderContent Catalog::selectChildren(FolderItem* parent) const
+{
+    FolderContent content;
+    int parentId = parent ? parent->id() : 0;
+
+    FoldersResult folders = CatalogStore::folderManager()->selectChildren(parentId);
+    if (!folders.error.isEmpty())
+    {
+        content.error = folders.error;
+        return content;
+    }
+
+    MemosResult memos = CatalogStore::memoManager()->selectChildren(parentId);
+    if (!memos.error.isEmpty())
+    {
+        qDeleteAll(folders.items);
+        content.error = memos.error;
+        return content;
+    }
+
+    if (!memos.warnings.isEmpty())
+        for (auto warning: memos.warnings)
+            qWarning() << warning;
+
+    content.folders = folders.items.values();
+    for (auto& items: memos.items)
+        content.memos.append(items);
+    return content;
+}
+
+/// Appends children selected by `selectChildren()` to the folder and marks it as populated.
+void Catalog::attachChildren(FolderItem* parent, const FolderContent& content)
+{
+    auto& children = parent ? parent->_children : _items;
+
+    for (FolderItem* item: content.folders)
+    {
+        item->_parent = parent;
+        CatalogItem::appendTo(children, item);
+        _allFolders.insert(item->id(), item);
+    }
+
+    for (MemoItem* item: content.memos)
+    {
+        item->_parent = parent;
+        CatalogItem::appendTo(children, item);
+        _allMemos.insert(item->id(), item);
+    }
+
+    if (parent)
+        parent->_isPopulated = true;
+}
+
+void Catalog::fetchMemoBranch(int memoId)
+{
+    int folderId;
+    QString res = CatalogStore::memoManager()->selectParentId(memoId, &folderId);
+    if (!res.isEmpty())
+    {
+        qWarning() << res;
+        return;
+    }
+
+    // Collect folders between the memo and the nearest folder that is already loaded
+    QVector<int> path;
+    while (folderId > 0 && !_allFolders.contains(folderId))
+    {
+        path.prepend(folderId);
+        res = CatalogStore::folderManager()->selectParentId(folderId, &folderId);
+        if (!res.isEmpty())
+        {
+            qWarning() << res;
+            return;
+        }
+    }
+
+    // Folders are populated silently, without notifying views.
+    // It's safe because a folder that is not populated has never been expanded,
+    // so a view doesn't know anything about its rows yet.
+    // Top level items are always loaded, so start from the first folder.
+    FolderItem* folder = folderId > 0 ? _allFolders[folderId] : nullptr;
+    for (int i = 0; ; i++)
+    {
+        if (folder)
+        {
+            auto fetched = fetchChildren(folder);
+            if (!fetched.ok())
+            {
+                qWarning() << fetched.error();
+                return;
+            }
+        }
+        if (i == path.size()) break;
+        folder = _allFolders.value(path.at(i));
+        if (!folder)
+        {
+            qWarning() << "Folder" << path.at(i) << "is not found in its parent folder";
+            return;
+        }
+    }
+}
+
 FolderResult Catalog::createFolder(FolderItem* parent, const QString& title)
 {
+    if (parent && !parent->isPopulated())
+    {
+        auto fetched = fetchChildren(parent);
+        if (!fetched.ok()) return FolderResult::fail(fetched.error());
+    }
+
     FolderItem* folder = new FolderItem;
     folder->_title = title;
     folder->_parent = parent;
@@ -200,8 +436,18 @@ FolderResult Catalog::createFolder(FolderItem* parent, const QString& title)
         return FolderResult::fail(res);
     }
 
-    (parent ? parent->_children : _items).append(folder);
+    CatalogItem::appendTo(parent ? parent->_children : _items, folder);
     _allFolders.insert(folder->id(), folder);
+
+    if (_batchDepth > 0)
+    {
+        _batchUndo.append([this, folder]{
+            CatalogItem::removeFrom(folder->parent() ? folder->parent()->asFolder()->_children : _items, folder);
+            _allFolders.remove(folder->id());
+            delete folder;
+        });
+        _batchFoldersChanged = true;
+    }
     // TODO sort items after inserting
 
     return FolderResult::ok(folder);
@@ -212,30 +458,80 @@ QString Catalog::removeFolder(FolderItem* item)
     QVector<CatalogItem*> subitems;
     fillSubitemsFlat(item, subitems);
 
+    // Memos of not loaded subfolders are unknown, so ids are taken from the database
+    QVector<int> memoIds;
+    QString res = CatalogStore::memoManager()->selectIdsInBranch(item->id(), &memoIds);
+    if (!res.isEmpty()) return res;
+
     // It removes all subfolders too
-    QString res = CatalogStore::folderManager()->remove(item);
+    res = CatalogStore::folderManager()->remove(item);
     if (!res.isEmpty()) return res;
 
-    (item->parent() ? item->parent()->asFolder()->_children : _items).removeOne(item);
+    int row = item->row();
+    CatalogItem::removeFrom(item->parent() ? item->parent()->asFolder()->_children : _items, item);
+
+    // Not loaded subfolders could contain memos too, it's simpler to recalculate everything
+    loadStats();
 
     for (auto subitem : subitems)
         if (subitem->isFolder())
             _allFolders.remove(subitem->id());
         else
         {
-            // Memo in DB was already deleted by FK relation
-            emit memoRemoved(dynamic_cast<MemoItem*>(subitem));
+            // Memo in DB was already deleted by FK relation.
+            // Inside a batch, it's forgotten on commit, as rollback brings it back.
+            auto memo = subitem->asMemo();
+            if (_batchDepth > 0)
+            {
+                _batchCreated.remove(memo);
+                _batchUpdated.remove(memo);
+                _batchRemoved.insert(memo);
+            }
+            else
+            {
+                emit memoRemoved(memo);
+                forgetMemo(memo);
+            }
             _allMemos.remove(subitem->id());
         }
 
     _allFolders.remove(item->id());
 
-    delete item;
+    res = CatalogStore::searchManager()->removeFromIndex(memoIds);
+    if (!res.isEmpty())
+        qWarning() << "Failed to remove memos of deleted folder from search index" << res;
+
+    // Memos of the folder are reported when the batch is committed, so it is deleted after that
+    if (_batchDepth > 0)
+    {
+        _batchUndo.append([this, item, row, subitems]{
+            CatalogItem::insertTo(item->parent() ? item->parent()->asFolder()->_children : _items, item, row);
+            _allFolders.insert(item->id(), item);
+            for (auto subitem : subitems)
+                if (subitem->isFolder())
+                    _allFolders.insert(subitem->id(), subitem->asFolder());
+                else _allMemos.insert(subitem->id(), subitem->asMemo());
+            _batchDeletingItems.removeOne(item);
+        });
+        _batchFoldersChanged = true;
+        _batchDeletingItems.append(item);
+    }
+    else delete item;
     return QString();
 }
 
 MemoResult Catalog::createMemo(FolderItem* parent, MemoItem* item, MemoType* memoType)
 {
+    if (parent && !parent->isPopulated())
+    {
+        auto fetched = fetchChildren(parent);
+        if (!fetched.ok())
+        {
+            delete item;
+            return MemoResult::fail(fetched.error());
+        }
+    }
+
     auto now = QDateTime::currentDateTime();
 
     item->_parent = parent;
@@ -251,11 +547,24 @@ MemoResult Catalog::createMemo(FolderItem* parent, MemoItem* item, MemoType* mem
         return MemoResult::fail(res);
     }
 
-    (parent ? parent->asFolder()->_children : _items).append(item);
+    CatalogItem::appendTo(parent ? parent->asFolder()->_children : _items, item);
     _allMemos.insert(item->id(), item);
+    _stats.addMemos(parent ? parent->id() : 0, memoType->name(), 1, item->data().size());
     // TODO sort items after inserting
 
-    emit memoCreated(item);
+    updateSearchIndex(item);
+
+    if (_batchDepth > 0)
+    {
+        _batchUndo.append([this, item]{
+            CatalogItem::removeFrom(item->parent() ? item->parent()->asFolder()->_children : _items, item);
+            _allMemos.remove(item->id());
+            forgetMemo(item);
+            delete item;
+        });
+        _batchCreated.insert(item);
+    }
+    else emit memoCreated(item);
 
     return MemoResult::ok(item);
 }
@@ -265,68 +574,633 @@ QString Catalog::updateMemo(MemoItem* item, MemoUpdateParam update)
     update.moment = QDateTime::currentDateTime();
     update.station = _station;
 
-    QString res = CatalogStore::memoManager()->update(item, update);
-    if (!res.isEmpty()) return res;
+    qint64 oldSize = storedDataSize(item);
+
+    // The previous text goes to history in the same transaction as the memo,
+    // inside a batch it's the batch transaction.
+    bool ownTransaction = _batchDepth == 0;
+    if (ownTransaction)
+    {
+        QString res = CatalogStore::beginWriteTransaction();
+        if (!res.isEmpty()) return res;
+    }
+    QString res = CatalogStore::historyManager()->addRevision(item->id(), update);
+    if (res.isEmpty())
+        res = CatalogStore::memoManager()->update(item->id(), update);
+    if (res.isEmpty() && ownTransaction)
+        res = CatalogStore::commitTransaction();
+    if (!res.isEmpty())
+    {
+        if (ownTransaction)
+            CatalogStore::rollbackTransaction();
+        return res;
+    }
+
+    if (_batchDepth > 0)
+    {
+        QString oldTitle = item->_title, oldData = item->_data, oldStation = item->_station;
+        QDateTime oldUpdated = item->_updated;
+        bool wasLoaded = item->_isLoaded;
+        _batchUndo.append([this, item, oldTitle, oldData, oldStation, oldUpdated, wasLoaded]{
+            item->_title = oldTitle;
+            item->_data = oldData;
+            item->_station = oldStation;
+            item->_updated = oldUpdated;
+            item->_isLoaded = wasLoaded;
+            if (wasLoaded)
+                _memoCache.touch(item);
+            else _memoCache.remove(item);
+        });
+    }
+
+    applyUpdate(item, update, oldSize);
+    updateSearchIndex(item);
+
+    if (_batchDepth > 0)
+    {
+        if (!_batchCreated.contains(item))
+            _batchUpdated.insert(item);
+    }
+    else emit memoUpdated(item);
+
+    // TODO sort items after renaming
+    return QString();
+}
+
+/// Saves memo in background without waiting for disk. The memo text is changed in memory at once,
+/// and `memoUpdated` or `memoSaveFailed` is emitted when the change is written.
+/// Until then, the memo keeps its previous modification time and size in statistics,
+/// and its recovery journal entry is not ended.
+/// Inside a batch, the memo is saved synchronously as a part of the batch transaction.
+QString Catalog::saveMemo(MemoItem* item, MemoUpdateParam update)
+{
+    if (_batchDepth > 0)
+        return updateMemo(item, update);
+
+    update.moment = QDateTime::currentDateTime();
+    update.station = _station;
+
+    if (!_memoWriter)
+    {
+        _memoWriter = new MemoWriter(_fileName, this);
+        connect(_memoWriter, &MemoWriter::saved, this, &Catalog::memoSaved);
+    }
+    _memoWriter->save(item->id(), update);
+
+    // Text that is not written yet must not be unloaded by the memo cache.
+    // What is stored is remembered from the first of unwritten changes.
+    auto saving = _savingMemos.find(item->id());
+    if (saving == _savingMemos.end())
+    {
+        _memoCache.pin(item->id());
+        saving = _savingMemos.insert(item->id(), { QDateTime(), storedDataSize(item), item->title(), false });
+    }
+    saving->moment = update.moment;
+    saving->isFailed = false;
 
     item->_title = update.title;
     item->_data = update.data;
+    item->_isLoaded = true;
+    _memoCache.touch(item);
+    return QString();
+}
+
+/// True when the memo is changed in memory and the change is being written in background.
+bool Catalog::isMemoSaving(MemoItem* item) const
+{
+    auto saving = _savingMemos.constFind(item->id());
+    return saving != _savingMemos.constEnd() && !saving->isFailed;
+}
+
+/// Discards the text of a memo which has failed to be saved and loads the stored one.
+/// Does nothing if the memo is saved or is still being saved.
+QString Catalog::revertMemo(MemoItem* item)
+{
+    auto saving = _savingMemos.find(item->id());
+    if (saving == _savingMemos.end() || !saving->isFailed) return QString();
+
+    item->_title = saving->storedTitle;
+    _savingMemos.erase(saving);
+    _memoCache.unpin(item->id());
+
+    QString res = CatalogStore::memoManager()->load(item);
+    if (res.isEmpty())
+        _memoCache.touch(item);
+
+    emit memoUpdated(item);
+    return res;
+}
+
+void Catalog::memoSaved(int memoId, const QDateTime& moment, const QString& error)
+{
+    // Results of previous saves don't matter when there is a newer one
+    auto saving = _savingMemos.find(memoId);
+    if (saving == _savingMemos.end() || saving->moment != moment) return;
+
+    auto item = _allMemos.value(memoId);
+    if (!item) return;
+
+    // The text stays pinned in memory until it's saved again or reverted,
+    // and its journal entry is kept, so the change can be recovered after a crash
+    if (!error.isEmpty())
+    {
+        saving->isFailed = true;
+        emit memoSaveFailed(item, error);
+        return;
+    }
+
+    // The change is on disk, there is nothing to recover anymore
+    _recoveryJournal->endMemo(memoId);
+
+    _stats.resizeMemo(item->parent() ? item->parent()->id() : 0, saving->storedSize, item->data().size());
+    item->_updated = moment;
+    item->_station = _station;
+
+    _savingMemos.erase(saving);
+    _memoCache.unpin(memoId);
+
+    emit memoUpdated(item);
+}
+
+void Catalog::applyUpdate(MemoItem* item, const MemoUpdateParam& update, qint64 oldSize)
+{
+    _stats.resizeMemo(item->parent() ? item->parent()->id() : 0, oldSize, update.data.size());
+
+    item->_title = update.title;
+    item->_data = update.data;
+    item->_isLoaded = true;
     item->_updated = update.moment;
     item->_station = update.station;
+    _memoCache.touch(item);
+}
 
-    emit memoUpdated(item);
+/// Loads memo text if it is not loaded yet or has been unloaded by the memo cache.
+QString Catalog::loadMemo(MemoItem* item)
+{
+    if (item->isLoaded())
+    {
+        _memoCache.countHit();
+        _memoCache.touch(item);
+        return QString();
+    }
 
-    // TODO sort items after renaming
+    _memoCache.countMiss();
+    QString res = CatalogStore::memoManager()->load(item);
+    if (!res.isEmpty()) return res;
+
+    _memoCache.touch(item);
     return QString();
 }
 
-QString Catalog::loadMemo(MemoItem* item)
+/// Loads texts of several memos at once, it's much faster than loading them one by one.
+QString Catalog::loadMemos(const QList<MemoItem*>& items)
 {
-    return CatalogStore::memoManager()->load(item);
+    QList<int> ids;
+    for (auto item : items)
+        if (!item->isLoaded())
+            ids << item->id();
+    if (ids.isEmpty()) return QString();
+
+    auto result = CatalogStore::memoManager()->selectData(ids);
+    if (!result.error.isEmpty()) return result.error;
+
+    applyMemoData(result);
+    return QString();
+}
+
+/// Starts loading texts of memos in background, they are likely to be opened soon.
+void Catalog::prefetchMemos(const QList<MemoItem*>& items)
+{
+    QList<int> ids;
+    for (auto item : items)
+        if (!item->isLoaded() && !_prefetchingIds.contains(item->id()))
+            ids << item->id();
+    if (ids.isEmpty()) return;
+
+    if (!_prefetcher)
+    {
+        _prefetcher = new MemoPrefetcher(_fileName, this);
+        connect(_prefetcher, &MemoPrefetcher::prefetched, this, &Catalog::memosPrefetched);
+    }
+    for (int id : ids)
+        _prefetchingIds.insert(id);
+    _prefetcher->prefetch(ids);
+}
+
+void Catalog::memosPrefetched(const QList<int>& ids, const MemoDataResult& result)
+{
+    for (int id : ids)
+        _prefetchingIds.remove(id);
+
+    // Prefetching is only an optimization, memos will be loaded when opened
+    if (!result.error.isEmpty())
+    {
+        qWarning() << "Failed to prefetch memos" << result.error;
+        return;
+    }
+    applyMemoData(result);
+}
+
+void Catalog::applyMemoData(const MemoDataResult& result)
+{
+    for (auto it = result.data.constBegin(); it != result.data.constEnd(); it++)
+    {
+        // Memo could be removed, or changed and loaded while its text was being read
+        auto item = _allMemos.value(it.key());
+        if (!item || item->isLoaded() || item->updated() != result.updated.value(it.key()))
+            continue;
+
+        item->_data = it.value();
+        item->_isLoaded = true;
+        _memoCache.touch(item);
+    }
 }
 
 QString Catalog::removeMemo(MemoItem* item)
 {
+    qint64 size = storedDataSize(item);
+
     QString res = CatalogStore::memoManager()->remove(item);
     if (!res.isEmpty()) return res;
 
-    (item->parent() ? item->parent()->asFolder()->_children : _items).removeOne(item);
+    _stats.removeMemo(item->parent() ? item->parent()->id() : 0, item->type()->name(), size);
+
+    int row = item->row();
+    CatalogItem::removeFrom(item->parent() ? item->parent()->asFolder()->_children : _items, item);
     _allMemos.remove(item->id());
 
-    emit memoRemoved(item);
+    res = CatalogStore::searchManager()->removeFromIndex(item->id());
+    if (!res.isEmpty())
+        qWarning() << "Failed to remove memo from search index" << item->id() << res;
+
+    // Inside a batch, the memo is forgotten on commit, as rollback brings it back
+    if (_batchDepth > 0)
+    {
+        _batchUndo.append([this, item, row]{
+            CatalogItem::insertTo(item->parent() ? item->parent()->asFolder()->_children : _items, item, row);
+            _allMemos.insert(item->id(), item);
+            _batchDeletingItems.removeOne(item);
+        });
+        _batchCreated.remove(item);
+        _batchUpdated.remove(item);
+        _batchRemoved.insert(item);
+        _batchDeletingItems.append(item);
+    }
+    else
+    {
+        emit memoRemoved(item);
+        forgetMemo(item);
+        delete item;
+    }
+    return QString();
+}
+
+/// Starts a transaction for all following operations until `commitBatch()` or `rollbackBatch()` is called.
+/// Batches can be nested, only the outermost one commits the transaction.
+QString Catalog::beginBatch()
+{
+    if (_batchDepth == 0)
+    {
+        QString res = CatalogStore::beginWriteTransaction();
+        if (!res.isEmpty()) return res;
+    }
+    _batchDepth++;
+    return QString();
+}
+
+/// Commits the batch transaction. When an inner batch has been rolled back,
+/// the outermost one is rolled back instead of committing.
+QString Catalog::commitBatch()
+{
+    if (_batchDepth == 0)
+    {
+        qWarning() << "Catalog::commitBatch() called without beginBatch()";
+        return QString();
+    }
+    if (_isBatchFailed && _batchDepth == 1)
+    {
+        QString res = rollbackBatch();
+        return res.isEmpty() ? tr("Changes are not saved because some of them have failed.") : res;
+    }
+    if (--_batchDepth > 0)
+        return QString();
+
+    QString res = CatalogStore::commitTransaction();
+    if (!res.isEmpty())
+        res = tr("Failed to save changes, the notebook should be reopened.\n\n%1").arg(res);
+
+    QList<CatalogItem*> deletingItems;
+    auto changes = takeBatchChanges(deletingItems);
+
+    for (auto item : changes.removedMemos)
+        forgetMemo(item);
+
+    // Items are already changed in memory, so views should know about them even if commit failed
+    if (!changes.isEmpty())
+        emit batchCommitted(changes);
 
-    delete item;
+    qDeleteAll(deletingItems);
+    return res;
+}
+
+/// Rolls back all operations made since the outermost `beginBatch()`.
+/// An inner batch only marks the whole batch as failed, the transaction is rolled back by the outermost one.
+/// Changes made in memory are reverted in reverse order, so items are the same as before the batch,
+/// and views that were not notified about the batch yet don't need to know about it.
+QString Catalog::rollbackBatch()
+{
+    if (_batchDepth == 0)
+    {
+        qWarning() << "Catalog::rollbackBatch() called without beginBatch()";
+        return QString();
+    }
+    if (--_batchDepth > 0)
+    {
+        _isBatchFailed = true;
+        return QString();
+    }
+    _isBatchFailed = false;
+
+    CatalogStore::rollbackTransaction();
+
+    // Each change is reverted in the state it was made in
+    auto undo = _batchUndo;
+    _batchUndo.clear();
+    for (int i = undo.size() - 1; i >= 0; i--)
+        undo.at(i)();
+
+    // Restored items have taken themselves out of this list
+    QList<CatalogItem*> deletingItems;
+    takeBatchChanges(deletingItems);
+
+    // Statistics were changed by operations of the batch
+    loadStats();
+
+    qDeleteAll(deletingItems);
     return QString();
 }
 
-IntResult Catalog::countMemos() const
+CatalogChanges Catalog::takeBatchChanges(QList<CatalogItem*>& deletingItems)
+{
+    CatalogChanges changes;
+    changes.createdMemos = _batchCreated.values().toVector();
+    changes.updatedMemos = _batchUpdated.values().toVector();
+    changes.removedMemos = _batchRemoved.values().toVector();
+    changes.foldersChanged = _batchFoldersChanged;
+    deletingItems = _batchDeletingItems;
+    _batchCreated.clear();
+    _batchUpdated.clear();
+    _batchRemoved.clear();
+    _batchDeletingItems.clear();
+    _batchUndo.clear();
+    _batchFoldersChanged = false;
+    return changes;
+}
+
+/// Starts compressing memos that were stored as plain text by previous program versions.
+/// It is done in background thread, the progress is stored in settings,
+/// so memos already processed (even those that could not be compressed) are not selected on next opening.
+void Catalog::startCompression()
+{
+    if (_compressor) return;
+
+    int afterId = CatalogStore::settingsManager()->readInt(KEY_COMPRESSED_UP_TO_ID, 0);
+    _compressor = new MemoCompressor(_fileName, afterId, this);
+    connect(_compressor, &MemoCompressor::progress, this, &Catalog::compressionProgress);
+    connect(_compressor, &MemoCompressor::finished, this, [](const QString& error){
+        if (!error.isEmpty())
+            qWarning() << "Failed to compress memos" << error;
+    });
+}
+
+void Catalog::compressionProgress(int lastId)
+{
+    CatalogStore::settingsManager()->writeInt(KEY_COMPRESSED_UP_TO_ID, lastId);
+    scheduleSettingsFlush();
+}
+
+void Catalog::scheduleSettingsFlush()
+{
+    if (!_settingsTimer)
+    {
+        _settingsTimer = new QTimer(this);
+        _settingsTimer->setSingleShot(true);
+        _settingsTimer->setInterval(SETTINGS_FLUSH_DELAY_MS);
+        connect(_settingsTimer, &QTimer::timeout, this, &Catalog::flushSettingsOnTimer);
+    }
+    if (!_settingsTimer->isActive())
+        _settingsTimer->start();
+}
+
+void Catalog::flushSettingsOnTimer()
+{
+    QString res = CatalogStore::settingsManager()->flush();
+    if (!res.isEmpty())
+        qWarning() << "Failed to store notebook settings" << res;
+}
+
+/// Starts updating the full-text search index in background thread.
+/// The index can be incomplete when the notebook was changed by a program version that doesn't know about it.
+void Catalog::startIndexing()
+{
+    if (_searchIndexer || !CatalogStore::searchManager()->isAvailable()) return;
+
+    _searchIndexer = new SearchIndexer(_fileName, this);
+    connect(_searchIndexer, &SearchIndexer::finished, this, [](const QString& error){
+        if (!error.isEmpty())
+            qWarning() << "Failed to update full-text search index" << error;
+    });
+}
+
+void Catalog::updateSearchIndex(MemoItem* item)
+{
+    // The search index is derived data, failing to update it should not fail the memo operation
+    QString res = CatalogStore::searchManager()->updateIndex(item->id(), item->title(), item->data());
+    if (!res.isEmpty())
+        qWarning() << "Failed to update search index for memo" << item->id() << res;
+}
+
+SearchResult Catalog::searchMemos(const QString& text, int limit) const
+{
+    return CatalogStore::searchManager()->search(text, limit);
+}
+
+MemoRevisionsResult Catalog::memoRevisions(MemoItem* item) const
+{
+    return CatalogStore::historyManager()->selectRevisions(item->id());
+}
+
+/// Restores the memo text as it was before the revision was replaced by the next save.
+QString Catalog::loadRevision(MemoItem* item, int revisionId, QString& data) const
+{
+    // History and memo text are read in one transaction, so the memo writer can't change them in between
+    bool ownTransaction = _batchDepth == 0;
+    if (ownTransaction)
+    {
+        QString res = CatalogStore::beginWriteTransaction();
+        if (!res.isEmpty()) return res;
+    }
+
+    QString res = CatalogStore::historyManager()->selectRevisionData(item->id(), revisionId, &data);
+
+    if (ownTransaction)
+        CatalogStore::commitTransaction();
+    return res;
+}
+
+/// Reads data that are kept in memory while the catalog is opened.
+void Catalog::loadCaches()
+{
+    loadStats();
+    loadMemoOptions();
+
+    _recoveryJournal = new RecoveryJournal(_fileName, this);
+
+    QString res = CatalogStore::settingsManager()->load();
+    if (!res.isEmpty())
+        qWarning() << "Failed to load notebook settings, they will be read from disk" << res;
+}
+
+void Catalog::loadStats()
+{
+    _statsError = CatalogStore::memoManager()->selectStats(&_stats);
+    if (!_statsError.isEmpty())
+        qWarning() << "Failed to calculate notebook statistics" << _statsError;
+}
+
+/// Options of all memos are loaded at once, it's faster than querying them for each opened memo.
+void Catalog::loadMemoOptions()
+{
+    auto result = CatalogStore::memoManager()->selectAllOptions();
+    if (!result.error.isEmpty())
+    {
+        qWarning() << "Failed to load memo options, they will be read for each memo" << result.error;
+        return;
+    }
+    _memoOptions = result.options;
+    _isMemoOptionsLoaded = true;
+}
+
+QMap<QString, QVariant> Catalog::memoOptions(int memoId) const
+{
+    if (!_isMemoOptionsLoaded)
+    {
+        auto options = CatalogStore::memoManager()->selectOptions(memoId);
+        auto pending = _pendingMemoOptions.value(memoId);
+        for (auto it = pending.constBegin(); it != pending.constEnd(); it++)
+            options[it.key()] = it.value();
+        return options;
+    }
+    return _memoOptions.value(memoId);
+}
+
+/// Options are stored in database later, see `flushMemoOptions()`.
+void Catalog::setMemoOption(int memoId, const QString& name, const QVariant& value)
+{
+    if (_isMemoOptionsLoaded)
+        _memoOptions[memoId][name] = value;
+    _pendingMemoOptions[memoId][name] = value;
+
+    if (!_memoOptionsTimer)
+    {
+        _memoOptionsTimer = new QTimer(this);
+        _memoOptionsTimer->setSingleShot(true);
+        _memoOptionsTimer->setInterval(MEMO_OPTIONS_FLUSH_DELAY_MS);
+        connect(_memoOptionsTimer, &QTimer::timeout, this, &Catalog::flushMemoOptionsOnTimer);
+    }
+    if (!_memoOptionsTimer->isActive())
+        _memoOptionsTimer->start();
+}
+
+/// Writes all changed memo options in one transaction.
+QString Catalog::flushMemoOptions()
 {
-    int count;
-    QString res = CatalogStore::memoManager()->countAll(&count);
-    return res.isEmpty() ? IntResult::ok(count) : IntResult::fail(res);
+    if (_pendingMemoOptions.isEmpty()) return QString();
+
+    if (_memoOptionsTimer)
+        _memoOptionsTimer->stop();
+
+    auto pending = _pendingMemoOptions;
+    _pendingMemoOptions.clear();
+
+    // Inside of a batch, options are committed together with it
+    bool ownTransaction = _batchDepth == 0;
+    QString res = ownTransaction ? CatalogStore::beginWriteTransaction() : QString();
+    if (!res.isEmpty()) return res;
+
+    for (auto memo = pending.constBegin(); memo != pending.constEnd() && res.isEmpty(); memo++)
+        for (auto option = memo.value().constBegin(); option != memo.value().constEnd() && res.isEmpty(); option++)
+            res = CatalogStore::memoManager()->updateOption(memo.key(), option.key(), option.value());
+
+    if (!ownTransaction) return res;
+
+    if (res.isEmpty())
+        return CatalogStore::commitTransaction();
+
+    CatalogStore::rollbackTransaction();
+    return res;
+}
+
+void Catalog::flushMemoOptionsOnTimer()
+{
+    QString res = flushMemoOptions();
+    if (!res.isEmpty())
+        qWarning() << "Failed to store memo options" << res;
+}
+
+/// Drops everything the catalog keeps in memory about a deleted memo.
+void Catalog::forgetMemo(MemoItem* item)
+{
+    _memoCache.remove(item);
+
+    // Options of deleted memo are deleted by FK cascade
+    _memoOptions.remove(item->id());
+    _pendingMemoOptions.remove(item->id());
+
+    if (_savingMemos.remove(item->id()) > 0)
+    {
+        _memoCache.unpin(item->id());
+        _recoveryJournal->endMemo(item->id());
+    }
+}
+
+/// Returns size of memo text as it's known by the statistics. Text of not loaded memo
+/// is not read, its size is stored separately, so it's cheap to query it.
+qint64 Catalog::storedDataSize(MemoItem* item) const
+{
+    if (item->isLoaded())
+        return item->data().size();
+
+    qint64 size = 0;
+    QString res = CatalogStore::memoManager()->selectDataSize(item->id(), &size);
+    if (!res.isEmpty())
+        qWarning() << "Failed to get memo size" << res;
+    return size;
 }
 
 namespace {
 
 template <typename TItem>
-TItem* findInContainerById(const QMap<int, TItem*>& container, int id)
+TItem* findInContainerById(const QHash<int, TItem*>& container, int id)
 {
     if (id <= 0)
     {
         qCritical() << "Invalid folder or memo id" << id;
         return nullptr;
     }
-    if (!container.contains(id))
-    {
+    auto item = container.value(id);
+    if (!item)
         qCritical() << "Inconsistent state! Catalog does not contain folder or memo" << id;
-        return nullptr;
-    }
-    return container[id];
+    return item;
 }
 
 } // namespace
 
-MemoItem* Catalog::findMemoById(int id) const
+MemoItem* Catalog::findMemoById(int id)
 {
+    if (_isLazy && id > 0 && !_allMemos.contains(id))
+        fetchMemoBranch(id);
+
     return findInContainerById(_allMemos, id);
 }
 
@@ -368,6 +1242,47 @@ QString Catalog::getOrMakeUid()
     {
         uid = QUuid::createUuid().toString();
         CatalogStore::settingsManager()->writeString(KEY_UID, uid);
+
+        // Other things can already refer to the notebook by this uid, so it must not be lost
+        QString res = CatalogStore::settingsManager()->flush();
+        if (!res.isEmpty())
+            qWarning() << "Failed to store notebook uid" << res;
     }
     return uid;
 }
+
+//------------------------------------------------------------------------------
+//                                CatalogBatch
+//------------------------------------------------------------------------------
+
+CatalogBatch::CatalogBatch(Catalog* catalog) : _catalog(catalog)
+{
+    _error = _catalog->beginBatch();
+}
+
+CatalogBatch::~CatalogBatch()
+{
+    QString res = rollback();
+    if (!res.isEmpty())
+        qWarning() << res;
+}
+
+QString CatalogBatch::commit()
+{
+    if (_isFinished || !_error.isEmpty())
+        return _error;
+
+    _isFinished = true;
+    _error = _catalog->commitBatch();
+    return _error;
+}
+
+/// Does nothing when the batch is already committed.
+QString CatalogBatch::rollback()
+{
+    if (_isFinished || !_error.isEmpty())
+        return QString();
+
+    _isFinished = true;
+    return _catalog->rollbackBatch();
+}
@@ -1,15 +1,37 @@
 #ifndef CATALOG_H
 #define CATALOG_H
 
+#include "CatalogStats.h"
+#include "HistoryManager.h"
+#include "MemoCache.h"
+#include "SearchManager.h"
+
 #include <QObject>
+#include <QHash>
 #include <QList>
 #include <QMap>
+#include <QSet>
 #include <QIcon>
 #include <QDateTime>
+#include <QVariant>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 class Catalog;
 class FolderItem;
+class MemoCompressor;
 class MemoItem;
+class MemoPrefetcher;
+class MemoWriter;
+class RecoveryJournal;
+class SearchIndexer;
+struct FoldersResult;
+struct MemoDataResult;
+struct MemosResult;
 
 //------------------------------------------------------------------------------
 
@@ -91,24 +113,43 @@ private:
 class CatalogItem
 {
 public:
+    /// Items are checked for their kind very often, e.g. on each painting
+    /// of the catalog tree, so a tag is used instead of dynamic_cast.
+    enum class Kind : quint8 { Folder, Memo };
+
     virtual ~CatalogItem();
 
+    Kind kind() const { return _kind; }
+
     int id() const { return _id; }
     const QString& title() const { return _title; }
     CatalogItem* parent() const { return _parent; }
     const QString path() const;
 
-    bool isFolder() const;
-    bool isMemo() const;
-    FolderItem* asFolder();
-    MemoItem* asMemo();
+    /// Position of the item among children of its parent, or among top level items.
+    int row() const { return _row; }
+
+    bool isFolder() const { return _kind == Kind::Folder; }
+    bool isMemo() const { return _kind == Kind::Memo; }
+    inline FolderItem* asFolder();
+    inline MemoItem* asMemo();
+
+protected:
+    explicit CatalogItem(Kind kind) : _kind(kind) {}
 
 private:
+    const Kind _kind;
     int _id;
     QString _title;
     CatalogItem* _parent = nullptr;
+    int _row = -1;
+
+    static void appendTo(QList<CatalogItem*>& items, CatalogItem* item);
+    static void insertTo(QList<CatalogItem*>& items, CatalogItem* item, int row);
+    static void removeFrom(QList<CatalogItem*>& items, CatalogItem* item);
 
     friend class Catalog;
+    friend class CatalogBenchmark;
     friend class FolderManager;
     friend class MemoManager;
 };
@@ -118,14 +159,20 @@ private:
 class FolderItem : public CatalogItem
 {
 public:
+    FolderItem() : CatalogItem(Kind::Folder) {}
     ~FolderItem();
 
     const QList<CatalogItem*>& children() const { return _children; }
 
+    /// False when the catalog is opened in lazy mode and the folder content is not loaded yet.
+    bool isPopulated() const { return _isPopulated; }
+
 private:
     QList<CatalogItem*> _children;
+    bool _isPopulated = true;
 
     friend class Catalog;
+    friend class CatalogBenchmark;
     friend class FolderManager;
 };
 
@@ -134,6 +181,7 @@ private:
 class MemoItem : public CatalogItem
 {
 public:
+    MemoItem() : CatalogItem(Kind::Memo) {}
     ~MemoItem();
 
     MemoType* type() { return _type; }
@@ -150,9 +198,40 @@ private:
     QDateTime _created, _updated;
 
     friend class Catalog;
+    friend class CatalogBenchmark;
+    friend class MemoCache;
     friend class MemoManager;
 };
 
+FolderItem* CatalogItem::asFolder() { return isFolder() ? static_cast<FolderItem*>(this) : nullptr; }
+MemoItem* CatalogItem::asMemo() { return isMemo() ? static_cast<MemoItem*>(this) : nullptr; }
+
+//------------------------------------------------------------------------------
+
+/// Changes made in a batch, they are reported at once when the batch is committed.
+struct CatalogChanges
+{
+    QVector<MemoItem*> createdMemos;
+    QVector<MemoItem*> updatedMemos;
+    /// Removed items are deleted right after the notification.
+    QVector<MemoItem*> removedMemos;
+    bool foldersChanged = false;
+
+    bool isEmpty() const;
+};
+
+//------------------------------------------------------------------------------
+
+/// Direct children of a folder selected from database but not attached to the folder yet.
+struct FolderContent
+{
+    QString error;
+    QList<FolderItem*> folders;
+    QList<MemoItem*> memos;
+
+    int size() const { return folders.size() + memos.size(); }
+};
+
 //------------------------------------------------------------------------------
 
 typedef OperationResult<int> IntResult;
@@ -172,41 +251,156 @@ public:
 
     static QString fileFilter();
     static QString defaultFileExt();
-    static CatalorResult open(const QString& fileName);
+    static CatalorResult open(const QString& fileName, bool lazy = false);
     static CatalorResult create(const QString& fileName);
 
     const QString& fileName() const { return _fileName; }
     const QList<CatalogItem*>& items() const { return _items; }
-    MemoItem* findMemoById(int id) const;
+    MemoItem* findMemoById(int id);
     FolderItem* findFolderById(int id) const;
 
+    bool isLazy() const { return _isLazy; }
+    IntResult fetchChildren(FolderItem* folder);
+    FolderContent selectChildren(FolderItem* folder) const;
+    void attachChildren(FolderItem* folder, const FolderContent& content);
+
     QString uid() const;
     QString getOrMakeUid();
 
-    IntResult countMemos() const;
+    const CatalogStats& stats() const { return _stats; }
+    const QString& statsError() const { return _statsError; }
+    SearchResult searchMemos(const QString& text, int limit = 100) const;
+
+    MemoRevisionsResult memoRevisions(MemoItem* item) const;
+    QString loadRevision(MemoItem* item, int revisionId, QString& data) const;
 
     QString renameFolder(FolderItem* item, const QString& title);
     FolderResult createFolder(FolderItem* parent, const QString& title);
     QString removeFolder(FolderItem* item);
     MemoResult createMemo(FolderItem* parent, MemoItem* item, MemoType *memoType);
     QString updateMemo(MemoItem* item, MemoUpdateParam update);
+    QString saveMemo(MemoItem* item, MemoUpdateParam update);
+    bool isMemoSaving(MemoItem* item) const;
+    QString revertMemo(MemoItem* item);
     QString removeMemo(MemoItem* item);
     QString loadMemo(MemoItem* item);
 
-    void fillSubitemsFlat(FolderItem* root, QVector<CatalogItem*> &subitems);
-    void fillMemoIdsFlat(FolderItem* root, QVector<int> &ids);
+    QMap<QString, QVariant> memoOptions(int memoId) const;
+    void setMemoOption(int memoId, const QString& name, const QVariant& value);
+    QString flushMemoOptions();
+
+    QString loadMemos(const QList<MemoItem*>& items);
+    void prefetchMemos(const QList<MemoItem*>& items);
+
+    MemoCache& memoCache() { return _memoCache; }
+
+    /// Unsaved changes of memos being edited, and those left by a crashed session.
+    RecoveryJournal* recoveryJournal() const { return _recoveryJournal; }
+
+    void startCompression();
+    void startIndexing();
+
+    QString beginBatch();
+    QString commitBatch();
+    QString rollbackBatch();
+    bool isBatchActive() const { return _batchDepth > 0; }
+
+    static void fillSubitemsFlat(FolderItem* root, QVector<CatalogItem*> &subitems);
+    static void fillMemoIdsFlat(FolderItem* root, QVector<int> &ids);
 
 signals:
     void memoCreated(MemoItem*);
     void memoRemoved(MemoItem*);
     void memoUpdated(MemoItem*);
+    void memoSaveFailed(MemoItem*, const QString& error);
+    /// Memos are going to be appended to the folder at the given rows, null folder means top level.
+    void memosAboutToBeLoaded(FolderItem* folder, int firstRow, int lastRow);
+    void memosLoaded();
+    void batchCommitted(const CatalogChanges& changes);
 
 private:
+    /// A memo whose text is changed in memory but not written yet, or failed to be written.
+    struct SavingMemo
+    {
+        QDateTime moment;
+        qint64 storedSize;
+        QString storedTitle;
+        bool isFailed;
+    };
+
     QString _fileName;
     QString _station;
     QList<CatalogItem*> _items;
-    QMap<int, MemoItem*> _allMemos;
-    QMap<int, FolderItem*> _allFolders;
+    QHash<int, MemoItem*> _allMemos;
+    QHash<int, FolderItem*> _allFolders;
+    bool _isLazy = false;
+    int _batchDepth = 0;
+    bool _isBatchFailed = false;
+    QSet<MemoItem*> _batchCreated, _batchUpdated, _batchRemoved;
+    QList<CatalogItem*> _batchDeletingItems;
+    QVector<std::function<void()>> _batchUndo;
+    bool _batchFoldersChanged = false;
+    MemoCache _memoCache;
+    CatalogStats _stats;
+    QString _statsError;
+    bool _isMemoOptionsLoaded = false;
+    QHash<int, QMap<QString, QVariant>> _memoOptions;
+    QHash<int, QMap<QString, QVariant>> _pendingMemoOptions;
+    QTimer* _memoOptionsTimer = nullptr;
+    QTimer* _settingsTimer = nullptr;
+    MemoPrefetcher* _prefetcher = nullptr;
+    MemoWriter* _memoWriter = nullptr;
+    RecoveryJournal* _recoveryJournal = nullptr;
+    QHash<int, SavingMemo> _savingMemos;
+    QSet<int> _prefetchingIds;
+    MemoCompressor* _compressor = nullptr;
+    SearchIndexer* _searchIndexer = nullptr;
+
+    void loadCaches();
+    void loadStats();
+    void loadMemoOptions();
+    void forgetMemo(MemoItem* item);
+    void memoSaved(int memoId, const QDateTime& moment, const QString& error);
+    void applyUpdate(MemoItem* item, const MemoUpdateParam& update, qint64 oldSize);
+    void flushMemoOptionsOnTimer();
+    void scheduleSettingsFlush();
+    void flushSettingsOnTimer();
+    qint64 storedDataSize(MemoItem* item) const;
+    void attachFolders(const FoldersResult& folders);
+    void attachMemos(const MemosResult& memos);
+    void updateSearchIndex(MemoItem* item);
+    void fetchMemoBranch(int memoId);
+    void compressionProgress(int lastId);
+    void memosPrefetched(const QList<int>& ids, const MemoDataResult& result);
+    void applyMemoData(const MemoDataResult& result);
+    CatalogChanges takeBatchChanges(QList<CatalogItem*>& deletingItems);
+
+    friend class CatalogLoader;
+};
+
+//------------------------------------------------------------------------------
+
+/// Groups catalog operations into one transaction while the guard exists.
+/// Signals about memo changes are not emitted separately for each memo,
+/// instead `Catalog::batchCommitted` is emitted once when the batch is committed.
+/// A batch should not span several iterations of the event loop,
+/// because views are not notified about changed items until the batch is committed.
+/// The batch is rolled back when the guard is destroyed without calling `commit()`,
+/// so an operation failed in the middle of the batch doesn't leave it applied partially.
+class CatalogBatch
+{
+public:
+    explicit CatalogBatch(Catalog* catalog);
+    ~CatalogBatch();
+
+    const QString& error() const { return _error; }
+    QString commit();
+    QString rollback();
+
+private:
+    Catalog* _catalog;
+    QString _error;
+    bool _isFinished = false;
 };
 
 #endif // CATALOG_H
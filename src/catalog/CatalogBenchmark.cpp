@@ -0,0 +1,273 @@
+#include "CatalogBenchmark.h"
+
+#include "Catalog.h"
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+
+using namespace Ori::Sql;
+
+namespace {
+
+const int MEMOS_PER_FOLDER = 100;
+const int PASS_COUNT = 10;
+
+// The same portion as the catalog loader reads
+const int MEMOS_BATCH_SIZE = 500;
+const int OPTIONS_PER_MEMO = 3;
+
+const QString CONNECTION_NAME("CatalogBenchmark");
+
+// Does the same checks as the catalog model does when the tree is painted
+int paintItem(CatalogItem* item)
+{
+    int result = item->title().size();
+    if (item->isFolder())
+        result += item->asFolder()->children().size();
+    else if (item->isMemo())
+        result += item->asMemo()->type() ? 1 : 0;
+    return result;
+}
+
+int paintTree(CatalogItem* item)
+{
+    int result = paintItem(item);
+    if (item->isFolder())
+        for (auto child : item->asFolder()->children())
+            result += paintTree(child);
+    return result;
+}
+
+// Baseline variants check item kinds with dynamic_cast, as it was done before items got kind tags
+int paintItemDynamic(CatalogItem* item)
+{
+    int result = item->title().size();
+    if (auto folder = dynamic_cast<FolderItem*>(item))
+        result += folder->children().size();
+    else if (auto memo = dynamic_cast<MemoItem*>(item))
+        result += memo->type() ? 1 : 0;
+    return result;
+}
+
+int paintTreeDynamic(CatalogItem* item)
+{
+    int result = paintItemDynamic(item);
+    if (auto folder = dynamic_cast<FolderItem*>(item))
+        for (auto child : folder->children())
+            result += paintTreeDynamic(child);
+    return result;
+}
+
+void fillSubitemsFlatDynamic(FolderItem* root, QVector<CatalogItem*>& subitems)
+{
+    for (auto item : root->children())
+    {
+        subitems.append(item);
+
+        if (auto folder = dynamic_cast<FolderItem*>(item))
+            fillSubitemsFlatDynamic(folder, subitems);
+    }
+}
+
+void fillMemoIdsFlatDynamic(FolderItem* root, QVector<int>& ids)
+{
+    for (auto item : root->children())
+    {
+        if (auto folder = dynamic_cast<FolderItem*>(item))
+            fillMemoIdsFlatDynamic(folder, ids);
+        else if (dynamic_cast<MemoItem*>(item))
+            ids.append(item->id());
+    }
+}
+
+// Returns the best time of several runs in milliseconds
+template <typename TFunc>
+double bestOf(TFunc func)
+{
+    QElapsedTimer timer;
+    qint64 bestNs = -1;
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        timer.start();
+        func();
+        qint64 ns = timer.nsecsElapsed();
+        if (bestNs < 0 || ns < bestNs) bestNs = ns;
+    }
+    return bestNs / 1e6;
+}
+
+// Reads memos by portions in the same way as the catalog loader does
+QString loadMemos(bool cached, int* count)
+{
+    int lastId = 0;
+    while (true)
+    {
+        // Without the cache each statement is parsed and planned again
+        if (!cached) clearStatementCache(CONNECTION_NAME);
+
+        MemosResult memos = CatalogStore::memoManager()->selectBatch(lastId, MEMOS_BATCH_SIZE);
+        if (!memos.error.isEmpty()) return memos.error;
+        if (memos.allMemos.isEmpty()) break;
+
+        lastId = memos.allMemos.lastKey();
+        *count += memos.allMemos.size();
+        qDeleteAll(memos.allMemos);
+    }
+    return QString();
+}
+
+// Reads options of each memo separately, as when memos are opened
+void readOptions(bool cached, int memoCount, int* count)
+{
+    for (int id = 1; id <= memoCount; id++)
+    {
+        if (!cached) clearStatementCache(CONNECTION_NAME);
+
+        *count += CatalogStore::memoManager()->selectOptions(id).size();
+    }
+}
+
+QString fillStore(int memoCount)
+{
+    QString res = CatalogStore::prepareDatabase();
+    if (!res.isEmpty()) return res;
+
+    res = CatalogStore::beginTransaction();
+    if (!res.isEmpty()) return res;
+
+    // Foreign keys are on, so memos must belong to an existing folder
+    ActionQuery insertFolder("INSERT INTO Folder (Parent, Title) VALUES (0, 'Benchmark')");
+    res = insertFolder.exec();
+    int folderId = insertFolder.lastInsertId().toInt();
+
+    for (int i = 1; i <= memoCount && res.isEmpty(); i++)
+    {
+        res = ActionQuery("INSERT INTO Memo (Id, Parent, Title, Type, Data) VALUES (:Id, :Parent, :Title, :Type, '')")
+                .param("Id", i)
+                .param("Parent", folderId)
+                .param("Title", QString("Memo %1").arg(i))
+                .param("Type", plainTextMemoType()->name())
+                .exec();
+        for (int j = 0; j < OPTIONS_PER_MEMO && res.isEmpty(); j++)
+            res = CatalogStore::memoManager()->updateOption(i, QString("Option%1").arg(j), j);
+    }
+    if (!res.isEmpty())
+    {
+        CatalogStore::rollbackTransaction();
+        return res;
+    }
+    return CatalogStore::commitTransaction();
+}
+
+} // namespace
+
+QString CatalogBenchmark::run(int itemCount, int storedMemoCount)
+{
+    return runTree(itemCount) + "\n\n" + runStore(storedMemoCount);
+}
+
+QString CatalogBenchmark::runStore(int memoCount)
+{
+    QTemporaryDir dir;
+    if (!dir.isValid())
+        return QString("Unable to create temporary directory.");
+
+    QStringList report;
+    report << QString("Notebook of %1 memos with %2 options each, best of %3 passes:")
+              .arg(memoCount).arg(OPTIONS_PER_MEMO).arg(PASS_COUNT);
+
+    QString res = CatalogStore::addConnection(CONNECTION_NAME, dir.filePath("benchmark.enot"));
+    if (res.isEmpty())
+    {
+        ConnectionGuard guard(CONNECTION_NAME);
+        int checksum = 0;
+
+        res = fillStore(memoCount);
+        for (bool cached : { false, true })
+        {
+            if (!res.isEmpty()) break;
+
+            QString mode = cached ? "cached statements" : "statements prepared on each call";
+            report << QString("Loading of memos by %1, %2: %3 ms").arg(MEMOS_BATCH_SIZE).arg(mode).arg(bestOf([&]{
+                if (res.isEmpty()) res = loadMemos(cached, &checksum);
+            }), 0, 'f', 3);
+            report << QString("Reading of options of each memo, %1: %2 ms").arg(mode).arg(bestOf([&]{
+                readOptions(cached, memoCount, &checksum);
+            }), 0, 'f', 3);
+        }
+
+        // Makes sure the compiler doesn't throw the measured code away
+        report << QString("Checksum: %1").arg(checksum);
+    }
+    CatalogStore::removeConnection(CONNECTION_NAME);
+
+    if (!res.isEmpty())
+        report << QString("Failed:\n%1").arg(res);
+    return report.join('\n');
+}
+
+QString CatalogBenchmark::runTree(int itemCount)
+{
+    QScopedPointer<FolderItem> root(new FolderItem);
+    root->_id = 1;
+    int nextId = 2;
+    int count = 0;
+    while (count < itemCount)
+    {
+        auto folder = new FolderItem;
+        folder->_id = nextId++;
+        folder->_title = QString("Folder %1").arg(folder->_id);
+        folder->_parent = root.data();
+        CatalogItem::appendTo(root->_children, folder);
+        count++;
+
+        for (int i = 0; i < MEMOS_PER_FOLDER && count < itemCount; i++)
+        {
+            auto memo = new MemoItem;
+            memo->_id = nextId++;
+            memo->_title = QString("Memo %1").arg(memo->_id);
+            memo->_type = plainTextMemoType();
+            memo->_parent = folder;
+            CatalogItem::appendTo(folder->_children, memo);
+            count++;
+        }
+    }
+
+    int checksum = 0;
+    QStringList report;
+    report << QString("Catalog of %1 items, best of %2 passes:").arg(count).arg(PASS_COUNT);
+
+    report << QString("Painting of whole tree: %1 ms (dynamic_cast: %2 ms)").arg(bestOf([&]{
+        checksum += paintTree(root.data());
+    }), 0, 'f', 3).arg(bestOf([&]{
+        checksum += paintTreeDynamic(root.data());
+    }), 0, 'f', 3);
+
+    report << QString("Flattening of subitems: %1 ms (dynamic_cast: %2 ms)").arg(bestOf([&]{
+        QVector<CatalogItem*> subitems;
+        Catalog::fillSubitemsFlat(root.data(), subitems);
+        checksum += subitems.size();
+    }), 0, 'f', 3).arg(bestOf([&]{
+        QVector<CatalogItem*> subitems;
+        fillSubitemsFlatDynamic(root.data(), subitems);
+        checksum += subitems.size();
+    }), 0, 'f', 3);
+
+    report << QString("Flattening of memo ids: %1 ms (dynamic_cast: %2 ms)").arg(bestOf([&]{
+        QVector<int> ids;
+        Catalog::fillMemoIdsFlat(root.data(), ids);
+        checksum += ids.size();
+    }), 0, 'f', 3).arg(bestOf([&]{
+        QVector<int> ids;
+        fillMemoIdsFlatDynamic(root.data(), ids);
+        checksum += ids.size();
+    }), 0, 'f', 3);
+
+    // Makes sure the compiler doesn't throw the measured code away
+    report << QString("Checksum: %1").arg(checksum);
+
+    return report.join('\n');
+}
@@ -0,0 +1,19 @@
+#ifndef CATALOG_BENCHMARK_H
+#define CATALOG_BENCHMARK_H
+
+#include <QString>
+
+/// Measures operations on in-memory catalog tree using a synthetic catalog,
+/// and reading of memos and their options from a temporary notebook.
+/// Returns a human readable report. Nothing is read from or written to the opened notebook.
+class CatalogBenchmark
+{
+public:
+    static QString run(int itemCount = 100000, int storedMemoCount = 10000);
+
+private:
+    static QString runTree(int itemCount);
+    static QString runStore(int memoCount);
+};
+
+#endif // CATALOG_BENCHMARK_H
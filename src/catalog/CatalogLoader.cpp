@@ -0,0 +1,204 @@
+#include "CatalogLoader.h"
+
+#include "Catalog.h"
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QCoreApplication>
+#include <QThread>
+
+namespace {
+
+// Big enough to not flood the GUI thread with events,
+// and small enough to see the progress on large catalogs.
+const int MEMOS_BATCH_SIZE = 500;
+
+} // namespace
+
+//------------------------------------------------------------------------------
+//                              CatalogLoaderWorker
+//------------------------------------------------------------------------------
+
+CatalogLoaderWorker::CatalogLoaderWorker(const QString& fileName, bool lazy, QAtomicInt* cancelled)
+    : StoreWorker(fileName), _lazy(lazy), _cancelled(cancelled)
+{
+}
+
+void CatalogLoaderWorker::started()
+{
+    QString res = openError();
+    if (res.isEmpty())
+    {
+        Ori::Sql::ConnectionGuard guard(connectionName());
+        res = load();
+    }
+    emit finished(res);
+}
+
+QString CatalogLoaderWorker::load()
+{
+    QString res = CatalogStore::prepareDatabase();
+    if (!res.isEmpty()) return res;
+
+    emit prepared();
+
+    // Top level items are loaded by catalog itself, it's fast enough
+    if (_lazy) return QString();
+
+    int total = 0;
+    res = CatalogStore::memoManager()->countAll(&total);
+    if (!res.isEmpty()) return res;
+
+    FoldersResult folders = CatalogStore::folderManager()->selectAll();
+    if (!folders.error.isEmpty()) return folders.error;
+
+    emit foldersLoaded(folders);
+
+    int loaded = 0;
+    int lastId = 0;
+    while (!_cancelled->load())
+    {
+        MemosResult memos = CatalogStore::memoManager()->selectBatch(lastId, MEMOS_BATCH_SIZE);
+        if (!memos.error.isEmpty()) return memos.error;
+
+        if (memos.allMemos.isEmpty()) break;
+
+        lastId = memos.allMemos.lastKey();
+        loaded += memos.allMemos.size();
+
+        emit memosLoaded(memos);
+        emit progress(loaded, qMax(loaded, total));
+    }
+    return QString();
+}
+
+//------------------------------------------------------------------------------
+//                                CatalogLoader
+//------------------------------------------------------------------------------
+
+CatalogLoader::CatalogLoader(const QString& fileName, bool lazy, QObject* parent)
+    : QObject(parent), _fileName(fileName), _lazy(lazy)
+{
+    qRegisterMetaType<FoldersResult>();
+    qRegisterMetaType<MemosResult>();
+}
+
+CatalogLoader::~CatalogLoader()
+{
+    cancel();
+}
+
+void CatalogLoader::start()
+{
+    auto worker = new CatalogLoaderWorker(_fileName, _lazy, &_cancelled);
+    _thread = StoreWorker::makeThread(worker, this);
+    connect(worker, &CatalogLoaderWorker::prepared, this, &CatalogLoader::workerPrepared);
+    connect(worker, &CatalogLoaderWorker::foldersLoaded, this, &CatalogLoader::workerFoldersLoaded);
+    connect(worker, &CatalogLoaderWorker::memosLoaded, this, &CatalogLoader::workerMemosLoaded);
+    connect(worker, &CatalogLoaderWorker::finished, this, &CatalogLoader::workerFinished);
+    connect(worker, &CatalogLoaderWorker::progress, this, [this](int loaded, int total){
+        if (!_cancelled.load()) emit progress(loaded, total);
+    });
+
+    _thread->start();
+}
+
+/// Stops loading and waits for the worker thread. Does nothing if loading is already finished.
+/// The catalog is not deleted if it has already been passed via the `opened` signal.
+void CatalogLoader::cancel()
+{
+    _cancelled.store(1);
+
+    StoreWorker::stopThread(_thread);
+
+    // Data selected by the worker but not delivered yet should be freed
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+
+    if (!_isCatalogPassed && _catalog)
+    {
+        delete _catalog;
+        _catalog = nullptr;
+    }
+}
+
+void CatalogLoader::workerPrepared()
+{
+    if (_cancelled.load()) return;
+
+    // Database structure is ready, now the main connection can be opened
+    QString res = CatalogStore::openConnection(_fileName);
+    if (!res.isEmpty())
+        return fail(res);
+
+    _catalog = new Catalog;
+    _catalog->_fileName = _fileName;
+    _catalog->_isLazy = _lazy;
+    _catalog->loadCaches();
+
+    if (_lazy)
+    {
+        auto topLevel = _catalog->fetchChildren(nullptr);
+        if (!topLevel.ok())
+            return fail(topLevel.error());
+
+        passCatalog();
+    }
+}
+
+void CatalogLoader::workerFoldersLoaded(FoldersResult folders)
+{
+    if (_cancelled.load() || !_catalog)
+    {
+        // Subfolders are deleted by their parents
+        for (auto item : folders.items)
+            if (!item->parent())
+                delete item;
+        return;
+    }
+
+    _catalog->attachFolders(folders);
+
+    passCatalog();
+}
+
+void CatalogLoader::workerMemosLoaded(MemosResult memos)
+{
+    if (_cancelled.load() || !_catalog)
+    {
+        qDeleteAll(memos.allMemos);
+        return;
+    }
+
+    _catalog->attachMemos(memos);
+}
+
+void CatalogLoader::workerFinished(const QString& error)
+{
+    StoreWorker::stopThread(_thread);
+
+    if (_cancelled.load()) return;
+
+    if (!error.isEmpty())
+        return fail(error);
+
+    emit finished(QString());
+}
+
+void CatalogLoader::fail(const QString& error)
+{
+    _cancelled.store(1);
+
+    if (!_isCatalogPassed && _catalog)
+    {
+        delete _catalog;
+        _catalog = nullptr;
+    }
+
+    emit finished(error);
+}
+
+void CatalogLoader::passCatalog()
+{
+    _isCatalogPassed = true;
+    emit opened(_catalog);
+}
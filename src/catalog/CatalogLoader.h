@@ -0,0 +1,91 @@
+#ifndef CATALOG_LOADER_H
+#define CATALOG_LOADER_H
+
+#include "FolderManager.h"
+#include "MemoManager.h"
+#include "StoreWorker.h"
+
+#include <QAtomicInt>
+#include <QMetaType>
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class Catalog;
+
+Q_DECLARE_METATYPE(FoldersResult)
+Q_DECLARE_METATYPE(MemosResult)
+
+//------------------------------------------------------------------------------
+
+/// Reads catalog database in a worker thread using its own connection.
+/// Memos are read in batches so the catalog tree can be shown before all of them are loaded.
+class CatalogLoaderWorker : public StoreWorker
+{
+    Q_OBJECT
+
+public:
+    CatalogLoaderWorker(const QString& fileName, bool lazy, QAtomicInt* cancelled);
+
+signals:
+    void prepared();
+    void foldersLoaded(FoldersResult folders);
+    void memosLoaded(MemosResult memos);
+    void progress(int loaded, int total);
+    void finished(const QString& error);
+
+protected:
+    void started() override;
+
+private:
+    bool _lazy;
+    QAtomicInt* _cancelled;
+
+    QString load();
+};
+
+//------------------------------------------------------------------------------
+
+/// Opens a catalog without blocking the GUI thread.
+/// Database structure is checked and upgraded in a worker thread,
+/// then the catalog is created with all folders and filled with memos progressively.
+/// In lazy mode, only top level items are loaded like `Catalog::open()` does.
+class CatalogLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    CatalogLoader(const QString& fileName, bool lazy, QObject* parent = nullptr);
+    ~CatalogLoader() override;
+
+    const QString& fileName() const { return _fileName; }
+
+    void start();
+    void cancel();
+
+signals:
+    /// Emitted when the catalog can be shown, ownership of the catalog is passed to receiver.
+    void opened(Catalog* catalog);
+    void progress(int loaded, int total);
+    /// Emitted when loading is done, the error is empty on success.
+    void finished(const QString& error);
+
+private:
+    QString _fileName;
+    bool _lazy;
+    QThread* _thread = nullptr;
+    QAtomicInt _cancelled;
+    Catalog* _catalog = nullptr;
+    bool _isCatalogPassed = false;
+
+    void workerPrepared();
+    void workerFoldersLoaded(FoldersResult folders);
+    void workerMemosLoaded(MemosResult memos);
+    void workerFinished(const QString& error);
+    void fail(const QString& error);
+    void passCatalog();
+};
+
+#endif // CATALOG_LOADER_H
@@ -0,0 +1,48 @@
+#include "CatalogStats.h"
+
+void CatalogStats::addMemos(int folderId, const QString& type, int count, qint64 size)
+{
+    _total.count += count;
+    _total.size += size;
+
+    auto& folder = _folders[folderId];
+    folder.count += count;
+    folder.size += size;
+
+    _types[type] += count;
+}
+
+void CatalogStats::removeMemo(int folderId, const QString& type, qint64 size)
+{
+    _total.count--;
+    _total.size -= size;
+
+    auto folder = _folders.find(folderId);
+    if (folder != _folders.end())
+    {
+        folder->count--;
+        folder->size -= size;
+        if (folder->count <= 0)
+            _folders.erase(folder);
+    }
+
+    auto typeCount = _types.find(type);
+    if (typeCount != _types.end() && --typeCount.value() <= 0)
+        _types.erase(typeCount);
+}
+
+void CatalogStats::resizeMemo(int folderId, qint64 oldSize, qint64 newSize)
+{
+    _total.size += newSize - oldSize;
+
+    auto folder = _folders.find(folderId);
+    if (folder != _folders.end())
+        folder->size += newSize - oldSize;
+}
+
+void CatalogStats::clear()
+{
+    _total = Counter();
+    _folders.clear();
+    _types.clear();
+}
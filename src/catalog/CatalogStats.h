@@ -0,0 +1,40 @@
+#ifndef CATALOG_STATS_H
+#define CATALOG_STATS_H
+
+#include <QHash>
+#include <QString>
+
+/// Statistics of memos in a catalog. They are read from database once when the catalog
+/// is opened and then updated in memory on each change, so showing them is free.
+/// Data size is the number of characters in memo texts, not the size on disk,
+/// because texts are stored compressed. Top level memos are counted in folder 0.
+class CatalogStats
+{
+public:
+    int memoCount() const { return _total.count; }
+    qint64 dataSize() const { return _total.size; }
+
+    int memoCount(int folderId) const { return _folders.value(folderId).count; }
+    qint64 dataSize(int folderId) const { return _folders.value(folderId).size; }
+
+    /// Memo type name -> memo count.
+    const QHash<QString, int>& typeCounts() const { return _types; }
+
+    void addMemos(int folderId, const QString& type, int count, qint64 size);
+    void removeMemo(int folderId, const QString& type, qint64 size);
+    void resizeMemo(int folderId, qint64 oldSize, qint64 newSize);
+    void clear();
+
+private:
+    struct Counter
+    {
+        int count = 0;
+        qint64 size = 0;
+    };
+
+    Counter _total;
+    QHash<int, Counter> _folders;
+    QHash<QString, int> _types;
+};
+
+#endif // CATALOG_STATS_H
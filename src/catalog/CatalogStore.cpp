@@ -6,47 +6,216 @@ namespace CatalogStore {
 
 MemoManager* memoManager() { static MemoManager m; return &m; }
 FolderManager *folderManager() { static FolderManager m; return &m; }
+HistoryManager* historyManager() { static HistoryManager m; return &m; }
+SearchManager* searchManager() { static SearchManager m; return &m; }
 SettingsManager* settingsManager() { static SettingsManager m; return &m; }
 
-QString openDatabase(const QString fileName)
+StoreConfig StoreConfig::fast()
 {
-    auto db = QSqlDatabase::database();
+    StoreConfig config;
+    config.name = "fast";
+    config.journalMode = "WAL";
+    config.synchronous = "NORMAL";
+    config.cacheSizeKb = 16384;
+    config.mmapSize = 256 * 1024 * 1024;
+    config.tempStore = "MEMORY";
+    return config;
+}
 
-    if (!db.isValid())
-        db = QSqlDatabase::addDatabase("QSQLITE");
+StoreConfig StoreConfig::safe()
+{
+    StoreConfig config;
+    config.name = "safe";
+    config.journalMode = "DELETE";
+    config.synchronous = "FULL";
+    config.cacheSizeKb = 8192;
+    config.mmapSize = 0;
+    config.tempStore = "MEMORY";
+    return config;
+}
 
-    if (db.isOpen())
-        db.close();
+StoreConfig StoreConfig::profile(const QString& name)
+{
+    if (name == QLatin1String("fast"))
+        return fast();
+    return safe();
+}
+
+namespace {
+
+StoreConfig& currentStoreConfig() { static StoreConfig config = StoreConfig::safe(); return config; }
 
+QString applyConfig(QSqlDatabase& db, const StoreConfig& config)
+{
+    QStringList pragmas {
+        QString("PRAGMA synchronous = %1").arg(config.synchronous),
+        // Negative value means kibibytes instead of pages
+        QString("PRAGMA cache_size = -%1").arg(config.cacheSizeKb),
+        QString("PRAGMA mmap_size = %1").arg(config.mmapSize),
+        QString("PRAGMA temp_store = %1").arg(config.tempStore),
+    };
+    QSqlQuery query(db);
+    for (const QString& pragma : pragmas)
+        if (!query.exec(pragma))
+            return QString("Failed to configure database connection.\n\n%1")
+                    .arg(SqlHelper::errorText(query, true));
+
+    // Journal mode can't be changed when another connection is using the database,
+    // and some file systems don't support WAL, it's not a reason to not open the file.
+    // The pragma returns the mode that is actually in effect.
+    if (query.exec(QString("PRAGMA journal_mode = %1").arg(config.journalMode)) && query.next())
+    {
+        auto journalMode = query.value(0).toString();
+        if (journalMode.compare(config.journalMode, Qt::CaseInsensitive) != 0)
+            qWarning() << "Journal mode" << config.journalMode << "is not applied, current mode is" << journalMode;
+    }
+    else qWarning() << "Failed to set journal mode" << SqlHelper::errorText(query);
+    query.finish();
+    return QString();
+}
+
+QString openAndConfigure(QSqlDatabase& db, const QString fileName, const StoreConfig& config)
+{
     db.setDatabaseName(fileName);
 
     if (!db.open())
         return QString("Unable to open database connection.\n\n%1")
                 .arg(SqlHelper::errorText(db.lastError()));
 
-    QSqlQuery query;
+    QSqlQuery query(db);
     if (!query.exec("PRAGMA foreign_keys = ON;"))
         return QString("Failed to enable foreign keys.\n\n%1")
                 .arg(SqlHelper::errorText(query));
 
+    return applyConfig(db, config);
+}
+
+} // namespace
+
+QString openDatabase(const QString fileName)
+{
+    QString res = openConnection(fileName);
+    if (!res.isEmpty()) return res;
+
+    return prepareDatabase();
+}
+
+/// Opens the default connection without checking the database structure.
+/// It's supposed that `prepareDatabase()` has been or will be called for the same file.
+QString openConnection(const QString fileName)
+{
+    auto db = QSqlDatabase::database();
+
+    if (!db.isValid())
+        db = QSqlDatabase::addDatabase("QSQLITE");
+
+    closeDatabase();
+
+    return openAndConfigure(db, fileName, storeConfig());
+}
+
+void setStoreConfig(const StoreConfig& config)
+{
+    currentStoreConfig() = config;
+}
+
+const StoreConfig& storeConfig()
+{
+    return currentStoreConfig();
+}
+
+/// Creates or upgrades the database structure using the connection of the current thread.
+QString prepareDatabase()
+{
+    auto db = Ori::Sql::database();
+
     bool ok = db.transaction();
     if (!ok)
         return QString("Failed to begin transaction for setup database structure.\n\n%1")
                 .arg(SqlHelper::errorText(db.lastError()));
 
-    QString res;
+    QString res = folderManager()->prepare();
+    if (res.isEmpty()) res = memoManager()->prepare();
+    if (res.isEmpty()) res = historyManager()->prepare();
+    if (res.isEmpty()) res = settingsManager()->prepare();
+    if (res.isEmpty()) res = searchManager()->prepare();
+    if (!res.isEmpty())
+    {
+        // Some steps roll back the transaction themselves, but not all of them
+        db.rollback();
+        return res;
+    }
 
-    res = folderManager()->prepare();
-    if (!res.isEmpty()) return res;
+    db.commit();
+    return QString();
+}
 
-    res = memoManager()->prepare();
-    if (!res.isEmpty()) return res;
+void closeDatabase()
+{
+    settingsManager()->unload();
+    auto db = QSqlDatabase::database(QSqlDatabase::defaultConnection, false);
+    Ori::Sql::clearStatementCache(db.connectionName());
+    if (db.isOpen())
+        db.close();
+}
 
-    res = settingsManager()->prepare();
-    if (!res.isEmpty()) return res;
+QString beginTransaction()
+{
+    auto db = Ori::Sql::database();
+    if (!db.transaction())
+        return QString("Unable to begin transaction.\n\n%1")
+                .arg(SqlHelper::errorText(db.lastError()));
+    return QString();
+}
 
-    db.commit();
+/// Starts a transaction that takes the write lock at once instead of at the first write.
+/// A deferred transaction of a connection that has read something can't wait for another
+/// connection to finish writing, SQLite fails it with SQLITE_BUSY without calling the busy handler.
+/// So this one should be used for all writing transactions, as workers write concurrently with the main connection.
+QString beginWriteTransaction()
+{
+    QSqlQuery query(Ori::Sql::database());
+    if (!query.exec("BEGIN IMMEDIATE"))
+        return QString("Unable to begin transaction.\n\n%1")
+                .arg(SqlHelper::errorText(query));
+    return QString();
+}
+
+QString commitTransaction()
+{
+    auto db = Ori::Sql::database();
+    if (!db.commit())
+    {
+        QString res = QString("Unable to commit transaction.\n\n%1")
+                .arg(SqlHelper::errorText(db.lastError()));
+        db.rollback();
+        return res;
+    }
     return QString();
 }
 
+void rollbackTransaction()
+{
+    Ori::Sql::database().rollback();
+}
+
+/// Opens a named connection for using in a worker thread.
+/// The connection must be added and removed in the same thread where it is used.
+QString addConnection(const QString& connectionName, const QString& fileName, const StoreConfig& config)
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    return openAndConfigure(db, fileName, config);
+}
+
+void removeConnection(const QString& connectionName)
+{
+    Ori::Sql::clearStatementCache(connectionName);
+    {
+        auto db = QSqlDatabase::database(connectionName, false);
+        if (db.isOpen())
+            db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
 } // namespace CatalogStore
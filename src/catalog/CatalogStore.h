@@ -3,15 +3,56 @@
 
 #include "MemoManager.h"
 #include "FolderManager.h"
+#include "HistoryManager.h"
+#include "SearchManager.h"
 #include "SettingsManager.h"
 
 namespace CatalogStore {
 
+/// Connection settings trading durability for speed.
+struct StoreConfig
+{
+    QString name;
+    QString journalMode;
+    QString synchronous;
+    int cacheSizeKb;
+    qint64 mmapSize;
+    QString tempStore;
+
+    /// Write-ahead log with syncs only at checkpoints, for notebooks on local drives.
+    /// WAL doesn't work over network file systems.
+    static StoreConfig fast();
+
+    /// Rollback journal with full syncs, for notebooks on network shares.
+    static StoreConfig safe();
+
+    /// Returns the safe profile when the name is unknown.
+    static StoreConfig profile(const QString& name);
+};
+
+/// The config is applied to connections that are opened after the call.
+void setStoreConfig(const StoreConfig& config);
+const StoreConfig& storeConfig();
+
 MemoManager* memoManager();
 FolderManager* folderManager();
+HistoryManager* historyManager();
+SearchManager* searchManager();
 SettingsManager* settingsManager();
 
 QString openDatabase(const QString fileName);
+QString openConnection(const QString fileName);
+QString prepareDatabase();
+void closeDatabase();
+
+QString beginTransaction();
+QString beginWriteTransaction();
+QString commitTransaction();
+void rollbackTransaction();
+
+QString addConnection(const QString& connectionName, const QString& fileName,
+                      const StoreConfig& config = storeConfig());
+void removeConnection(const QString& connectionName);
 
 } // namespace CatalogStore
 
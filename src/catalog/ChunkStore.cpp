@@ -0,0 +1,316 @@
+#include "ChunkStore.h"
+
+#include "MemoManager.h"
+#include "SqlHelper.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QHash>
+
+using namespace Ori::Sql;
+
+namespace ChunkStore {
+
+namespace {
+
+// Memo data referencing chunks is stored as BLOB starting with this marker,
+// as compressed data is. It's followed by ids of chunks in order of their appearance.
+const QByteArray CHUNKED_DATA_MARKER("PC1:");
+
+// Sizes are in characters. The average chunk is about 2K, the mask defines it.
+const int MIN_TEXT_SIZE = 4096;
+const int MIN_CHUNK_SIZE = 512;
+const int MAX_CHUNK_SIZE = 8192;
+const quint32 CHUNK_BOUNDARY_MASK = (1 << 11) - 1;
+
+class ChunkTableDef : public TableDef
+{
+public:
+    ChunkTableDef() : TableDef("MemoChunk") {}
+
+    const QString id = "Id";
+    const QString hash = "Hash";
+    const QString data = "Data";
+    const QString dataSize = "DataSize";
+    const QString storedSize = "StoredSize";
+
+    // Data is encoded as Memo.Data is, so big chunks are compressed
+    QString sqlCreate() const override {
+        return "CREATE TABLE IF NOT EXISTS MemoChunk ("
+               "Id INTEGER PRIMARY KEY, Hash UNIQUE, Data, DataSize, StoredSize, RefCount DEFAULT 0)";
+    }
+
+    const QString sqlSelectByHash = "SELECT Id FROM MemoChunk WHERE Hash = :Hash";
+    const QString sqlSelectData = "SELECT Data FROM MemoChunk WHERE Id = :Id";
+
+    const QString sqlInsert =
+        "INSERT INTO MemoChunk (Hash, Data, DataSize, StoredSize) "
+        "VALUES (:Hash, :Data, :DataSize, :StoredSize)";
+
+    // Chunks can be left unreferenced if a program version not knowing about them removed memos
+    const QString sqlDeleteUnused = "DELETE FROM MemoChunk WHERE RefCount <= 0";
+
+    const QString sqlSelectStats =
+        "SELECT COUNT(*), SUM(RefCount), SUM(StoredSize), SUM(StoredSize * RefCount) FROM MemoChunk";
+};
+
+class ChunkRefTableDef : public TableDef
+{
+public:
+    ChunkRefTableDef() : TableDef("MemoChunkRef") {}
+
+    const QString id = "Id";
+    const QString memoId = "MemoId";
+    const QString chunkId = "ChunkId";
+
+    QString sqlCreate() const override {
+        return "CREATE TABLE IF NOT EXISTS MemoChunkRef ("
+               "Id INTEGER PRIMARY KEY, "
+               "MemoId REFERENCES Memo(Id) ON DELETE CASCADE, "
+               "ChunkId)";
+    }
+
+    // References deleted by cascade on memo or folder removal fire the triggers too
+    const QString sqlCreateInsertTrigger =
+        "CREATE TRIGGER IF NOT EXISTS MemoChunkRef_Insert AFTER INSERT ON MemoChunkRef BEGIN "
+        "UPDATE MemoChunk SET RefCount = RefCount + 1 WHERE Id = NEW.ChunkId; "
+        "END";
+    const QString sqlCreateDeleteTrigger =
+        "CREATE TRIGGER IF NOT EXISTS MemoChunkRef_Delete AFTER DELETE ON MemoChunkRef BEGIN "
+        "UPDATE MemoChunk SET RefCount = RefCount - 1 WHERE Id = OLD.ChunkId; "
+        "DELETE FROM MemoChunk WHERE Id = OLD.ChunkId AND RefCount <= 0; "
+        "END";
+
+    const QString sqlSelectLastId = "SELECT ifnull(MAX(Id), 0) FROM MemoChunkRef WHERE MemoId = :MemoId";
+    const QString sqlInsert = "INSERT INTO MemoChunkRef (MemoId, ChunkId) VALUES (:MemoId, :ChunkId)";
+    const QString sqlDeleteOld = "DELETE FROM MemoChunkRef WHERE MemoId = :MemoId AND Id <= :Id";
+};
+
+ChunkTableDef* chunkTable() { static ChunkTableDef t; return &t; }
+ChunkRefTableDef* chunkRefTable() { static ChunkRefTableDef t; return &t; }
+
+// Random values for the gear rolling hash. They are generated by a fixed
+// generator instead of qrand() because chunk boundaries must never change.
+struct GearTable
+{
+    quint32 values[256];
+
+    GearTable()
+    {
+        quint32 x = 0x9E3779B9;
+        for (int i = 0; i < 256; i++)
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            values[i] = x;
+        }
+    }
+};
+
+const quint32* gearTable() { static GearTable t; return t.values; }
+
+// Returns start positions of chunks
+QVector<int> splitChunks(const QString& text)
+{
+    auto gear = gearTable();
+    QVector<int> starts;
+    int start = 0;
+    quint32 hash = 0;
+    for (int i = 0; i < text.size(); i++)
+    {
+        ushort c = text.at(i).unicode();
+        hash = (hash << 1) + gear[(c ^ (c >> 8)) & 0xFF];
+
+        int length = i + 1 - start;
+        if (length < MIN_CHUNK_SIZE) continue;
+        if ((hash & CHUNK_BOUNDARY_MASK) != 0 && length < MAX_CHUNK_SIZE) continue;
+        if (text.at(i).isHighSurrogate()) continue;
+
+        starts.append(start);
+        start = i + 1;
+        hash = 0;
+    }
+    if (start < text.size())
+        starts.append(start);
+    return starts;
+}
+
+} // namespace
+
+QString prepare()
+{
+    auto chunks = chunkTable();
+    auto refs = chunkRefTable();
+
+    QString res = createTable(chunks);
+    if (!res.isEmpty()) return res;
+
+    res = createTable(refs);
+    if (!res.isEmpty()) return res;
+
+    res = createIndexIfNotExist(refs->tableName(), refs->memoId);
+    if (!res.isEmpty()) return res;
+
+    res = ActionQuery(refs->sqlCreateInsertTrigger).exec();
+    if (res.isEmpty()) res = ActionQuery(refs->sqlCreateDeleteTrigger).exec();
+    if (!res.isEmpty())
+        return QString("Unable to create triggers for memo chunks.\n\n%1").arg(res);
+
+    res = ActionQuery(chunks->sqlDeleteUnused).exec();
+    if (!res.isEmpty())
+        return QString("Unable to remove unused memo chunks.\n\n%1").arg(res);
+
+    return QString();
+}
+
+bool isChunkable(const QString& text)
+{
+    return text.size() >= MIN_TEXT_SIZE;
+}
+
+QString write(const QString& text, QVector<int>* chunkIds)
+{
+    auto table = chunkTable();
+
+    chunkIds->clear();
+    auto starts = splitChunks(text);
+    for (int i = 0; i < starts.size(); i++)
+    {
+        int end = i < starts.size() - 1 ? starts.at(i + 1) : text.size();
+        QString chunk = text.mid(starts.at(i), end - starts.at(i));
+        QByteArray utf8 = chunk.toUtf8();
+        QByteArray hash = QCryptographicHash::hash(utf8, QCryptographicHash::Sha1);
+
+        {
+            SelectQuery query(table->sqlSelectByHash, {{ table->hash, hash }});
+            if (query.isFailed())
+                return QString("Unable to find memo chunk.\n\n%1").arg(query.error());
+            if (query.next())
+            {
+                chunkIds->append(query.record().value(0).toInt());
+                continue;
+            }
+        }
+
+        QVariant data = MemoManager::encodeData(chunk);
+        ActionQuery query(table->sqlInsert);
+        auto res = query
+                .param(table->hash, hash)
+                .param(table->data, data)
+                .param(table->dataSize, chunk.size())
+                .param(table->storedSize, data.type() == QVariant::ByteArray ? data.toByteArray().size() : utf8.size())
+                .exec();
+        if (!res.isEmpty())
+            return QString("Unable to store memo chunk.\n\n%1").arg(res);
+        chunkIds->append(query.lastInsertId().toInt());
+    }
+    return QString();
+}
+
+QString attach(int memoId, const QVector<int>& chunkIds)
+{
+    auto table = chunkRefTable();
+
+    int lastOldId;
+    {
+        SelectQuery query(table->sqlSelectLastId, {{ table->memoId, memoId }});
+        if (query.isFailed())
+            return QString("Unable to get chunks of memo #%1.\n\n%2").arg(memoId).arg(query.error());
+        query.next();
+        lastOldId = query.record().value(0).toInt();
+    }
+
+    for (int chunkId : chunkIds)
+    {
+        auto res = ActionQuery(table->sqlInsert)
+                .param(table->memoId, memoId)
+                .param(table->chunkId, chunkId)
+                .exec();
+        if (!res.isEmpty())
+            return QString("Unable to reference chunk of memo #%1.\n\n%2").arg(memoId).arg(res);
+    }
+
+    if (lastOldId == 0) return QString();
+
+    auto res = ActionQuery(table->sqlDeleteOld)
+            .param(table->memoId, memoId)
+            .param(table->id, lastOldId)
+            .exec();
+    if (!res.isEmpty())
+        return QString("Unable to release old chunks of memo #%1.\n\n%2").arg(memoId).arg(res);
+    return QString();
+}
+
+QByteArray makeRef(const QVector<int>& chunkIds)
+{
+    QByteArray ref(CHUNKED_DATA_MARKER);
+    QDataStream stream(&ref, QIODevice::Append);
+    for (int chunkId : chunkIds)
+        stream << qint32(chunkId);
+    return ref;
+}
+
+bool isRef(const QByteArray& value)
+{
+    return value.startsWith(CHUNKED_DATA_MARKER);
+}
+
+QString read(const QByteArray& ref, QString* text)
+{
+    auto table = chunkTable();
+
+    QDataStream stream(ref.mid(CHUNKED_DATA_MARKER.size()));
+
+    // The same chunk can repeat in a text
+    QHash<int, QString> loaded;
+    text->clear();
+    while (!stream.atEnd())
+    {
+        qint32 chunkId;
+        stream >> chunkId;
+        if (stream.status() != QDataStream::Ok)
+            return QString("Chunk reference is damaged.");
+
+        auto it = loaded.constFind(chunkId);
+        if (it != loaded.constEnd())
+        {
+            text->append(it.value());
+            continue;
+        }
+
+        SelectQuery query(table->sqlSelectData, {{ table->id, chunkId }});
+        if (query.isFailed())
+            return QString("Unable to load memo chunk #%1.\n\n%2").arg(chunkId).arg(query.error());
+        if (!query.next())
+            return QString("Memo chunk #%1 does not exist.").arg(chunkId);
+
+        bool ok;
+        QString chunk = MemoManager::decodeData(query.record().value(0), &ok);
+        if (!ok)
+            return QString("Memo chunk #%1 is corrupted.").arg(chunkId);
+
+        text->append(chunk);
+        loaded.insert(chunkId, chunk);
+    }
+    return QString();
+}
+
+QString selectStats(Stats* stats)
+{
+    SelectQuery query(chunkTable()->sqlSelectStats);
+    if (query.isFailed())
+        return QString("Unable to calculate statistics of memo chunks.\n\n%1").arg(query.error());
+
+    if (query.next())
+    {
+        auto r = query.record();
+        stats->chunkCount = r.value(0).toLongLong();
+        stats->refCount = r.value(1).toLongLong();
+        stats->storedBytes = r.value(2).toLongLong();
+        stats->referencedBytes = r.value(3).toLongLong();
+    }
+    return QString();
+}
+
+} // namespace ChunkStore
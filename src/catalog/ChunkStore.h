@@ -0,0 +1,47 @@
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+/// Content-addressed storage of memo texts.
+/// A big text is split into chunks at positions defined by the content itself,
+/// so the same fragment pasted into different memos gives the same chunks.
+/// Chunks are keyed by their hash and stored once, memos only reference them.
+/// References are rows of a table cascading on memo removal, reference counters
+/// of chunks are maintained by triggers and chunks are deleted when they are not referenced.
+namespace ChunkStore {
+
+struct Stats
+{
+    qint64 chunkCount = 0;
+    qint64 refCount = 0;
+    qint64 storedBytes = 0;
+    qint64 referencedBytes = 0;
+};
+
+QString prepare();
+
+/// Texts shorter than this are stored in memos directly.
+bool isChunkable(const QString& text);
+
+/// Stores chunks of the text, existing chunks are reused.
+/// Written chunks must be attached to a memo in the same transaction,
+/// otherwise they can be deleted as unreferenced ones.
+QString write(const QString& text, QVector<int>* chunkIds);
+
+/// Adds references of the memo to chunks. Old references of the memo are released
+/// after new ones are added, so chunks shared by the old and new text survive.
+QString attach(int memoId, const QVector<int>& chunkIds);
+
+/// Makes a value of Memo.Data column referencing the chunks.
+QByteArray makeRef(const QVector<int>& chunkIds);
+bool isRef(const QByteArray& value);
+QString read(const QByteArray& ref, QString* text);
+
+QString selectStats(Stats* stats);
+
+} // namespace ChunkStore
+
+#endif // CHUNK_STORE_H
@@ -26,12 +26,30 @@ public:
                "Parent, Title)";
     }
 
+    // Id is generated by database, it is an alias for rowid
     const QString sqlInsert =
-        "INSERT INTO Folder (Id, Parent, Title) "
-        "VALUES (:Id, :Parent, :Title)";
+        "INSERT INTO Folder (Parent, Title) "
+        "VALUES (:Parent, :Title)";
 
     const QString sqlRename = "UPDATE Folder SET Title = :Title WHERE Id = :Id";
     const QString sqlDelete = "DELETE FROM Folder WHERE Id = :Id";
+
+    // Subfolders of a folder whose content is not loaded yet are unknown to the catalog,
+    // so they are collected by the database itself. Memos are deleted by FK cascade.
+    const QString sqlDeleteSubfolders =
+        "WITH RECURSIVE Branch(Id) AS ("
+            "SELECT Id FROM Folder WHERE Parent = :Id "
+            "UNION ALL "
+            "SELECT Folder.Id FROM Folder JOIN Branch ON Folder.Parent = Branch.Id) "
+        "DELETE FROM Folder WHERE Id IN Branch";
+
+    const QString sqlSavepoint = "SAVEPOINT RemoveFolder";
+    const QString sqlReleaseSavepoint = "RELEASE RemoveFolder";
+    const QString sqlRollbackToSavepoint = "ROLLBACK TO RemoveFolder";
+
+    const QString sqlSelectByParent = "SELECT * FROM Folder WHERE Parent = :Parent";
+    const QString sqlSelectTopLevel = "SELECT * FROM Folder WHERE Parent IS NULL OR Parent = 0";
+    const QString sqlSelectParentById = "SELECT Parent FROM Folder WHERE Id = :Id";
 };
 
 FolderTableDef* folderTable() { static FolderTableDef t; return &t; }
@@ -44,27 +62,27 @@ FolderTableDef* folderTable() { static FolderTableDef t; return &t; }
 
 QString FolderManager::prepare()
 {
-    return createTable(folderTable());
+    auto table = folderTable();
+
+    QString res = createTable(table);
+    if (!res.isEmpty()) return res;
+
+    return createIndexIfNotExist(table->tableName(), table->parent);
 }
 
 QString FolderManager::create(FolderItem* folder) const
 {
     auto table = folderTable();
 
-    SelectQuery queryId(table->sqlSelectMaxId());
-    if (queryId.isFailed() || !queryId.next())
-        return qApp->tr("Unable to generate id for new folder.\n\n%1").arg(queryId.error());
-
-    folder->_id = queryId.record().value(0).toInt() + 1;
-
-    auto res = ActionQuery(table->sqlInsert)
-                .param(table->id, folder->id())
+    ActionQuery query(table->sqlInsert);
+    auto res = query
                 .param(table->parent, folder->parent() ? folder->parent()->asFolder()->id() : 0)
                 .param(table->title, folder->title())
                 .exec();
     if (!res.isEmpty())
         return qApp->tr("Failed to create new folder.\n\n%1").arg(res);
 
+    folder->_id = query.lastInsertId().toInt();
     return QString();
 }
 
@@ -96,7 +114,7 @@ FoldersResult FolderManager::selectAll() const
             if (!result.items.contains(parentId))
                 result.items.insert(parentId, new FolderItem);
             auto parentItem = result.items[parentId];
-            parentItem->_children.append(item);
+            CatalogItem::appendTo(parentItem->_children, item);
             item->_parent = parentItem;
         }
     }
@@ -104,6 +122,51 @@ FoldersResult FolderManager::selectAll() const
     return result;
 }
 
+FoldersResult FolderManager::selectChildren(int parentId) const
+{
+    FoldersResult result;
+
+    auto table = folderTable();
+
+    QString sql = parentId > 0 ? table->sqlSelectByParent : table->sqlSelectTopLevel;
+    QMap<QString, QVariant> params;
+    if (parentId > 0)
+        params[table->parent] = parentId;
+
+    SelectQuery query(sql, params);
+    if (query.isFailed())
+    {
+        result.error = qApp->tr("Unable to load subfolders of folder #%1.\n\n%2").arg(parentId).arg(query.error());
+        return result;
+    }
+
+    while (query.next())
+    {
+        auto r = query.record();
+        auto item = new FolderItem;
+        item->_id = r.value(table->id).toInt();
+        item->_title = r.value(table->title).toString();
+        item->_isPopulated = false;
+        result.items.insert(item->id(), item);
+    }
+
+    return result;
+}
+
+QString FolderManager::selectParentId(int folderId, int* parentId) const
+{
+    auto table = folderTable();
+    SelectQuery query(table->sqlSelectParentById, {{ table->id, folderId }});
+    if (query.isFailed())
+        return qApp->tr("Unable to get parent of folder #%1.\n\n%2").arg(folderId).arg(query.error());
+
+    if (!query.next())
+        return qApp->tr("Folder #%1 does not exist.").arg(folderId);
+
+    *parentId = query.record().value(0).toInt();
+    return QString();
+}
+
 QString FolderManager::rename(int folderId, const QString title) const
 {
     auto table = folderTable();
@@ -115,20 +178,24 @@ QString FolderManager::rename(int folderId, const QString title) const
 
 QString FolderManager::remove(FolderItem *folder) const
 {
-    auto db = QSqlDatabase::database();
-    bool ok = db.transaction();
-    if (!ok)
-        return QString("Unable to start transaction for removing folder #%1.\n\n%2")
-                .arg(folder->id()).arg(SqlHelper::errorText(db.lastError()));
+    auto table = folderTable();
 
-    QString res = removeBranch(folder, QString());
+    // Savepoint works as a nested transaction when the folder is removed in a catalog batch
+    QString res = ActionQuery(table->sqlSavepoint).exec();
+    if (!res.isEmpty())
+        return QString("Unable to start transaction for removing folder #%1.\n\n%2").arg(folder->id()).arg(res);
+
+    res = removeBranch(folder, QString());
     if (!res.isEmpty())
     {
-        db.rollback();
+        ActionQuery(table->sqlRollbackToSavepoint).exec();
+        ActionQuery(table->sqlReleaseSavepoint).exec();
         return res;
     }
 
-    db.commit();
+    res = ActionQuery(table->sqlReleaseSavepoint).exec();
+    if (!res.isEmpty())
+        return QString("Unable to commit removing of folder #%1.\n\n%2").arg(folder->id()).arg(res);
     return QString();
 }
 
@@ -137,6 +204,15 @@ QString FolderManager::removeBranch(FolderItem* folder, const QString& path) con
     auto table = folderTable();
     QString thisPath = path + '/' + folder->title();
 
+    if (!folder->isPopulated())
+    {
+        QString res = ActionQuery(table->sqlDeleteSubfolders)
+                .param(table->id, folder->id())
+                .exec();
+        if (!res.isEmpty())
+            return QString("Failed to delete subfolders of folder '%1'.\n\n%2").arg(thisPath).arg(res);
+    }
+
     for (auto item: folder->children())
         if (item->isFolder())
         {
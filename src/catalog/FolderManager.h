@@ -21,6 +21,8 @@ public:
     QString rename(int folderId, const QString title) const;
     QString remove(FolderItem* folder) const;
     FoldersResult selectAll() const;
+    FoldersResult selectChildren(int parentId) const;
+    QString selectParentId(int folderId, int* parentId) const;
 
 private:
     QString removeBranch(FolderItem* folder, const QString &path) const;
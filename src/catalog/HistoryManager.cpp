@@ -0,0 +1,236 @@
+#include "HistoryManager.h"
+
+#include "Catalog.h"
+#include "MemoManager.h"
+#include "SqlHelper.h"
+#include "TextDelta.h"
+
+using namespace Ori::Sql;
+
+//------------------------------------------------------------------------------
+//                              HistoryTableDef
+//------------------------------------------------------------------------------
+
+namespace {
+
+// Max number of deltas applied to restore a revision
+const int MAX_DELTA_CHAIN = 16;
+
+class HistoryTableDef : public TableDef
+{
+public:
+    HistoryTableDef() : TableDef("MemoHistory") {}
+
+    const QString id = "Id";
+    const QString memoId = "MemoId";
+    const QString moment = "Moment";
+    const QString station = "Station";
+    const QString title = "Title";
+    const QString snapshot = "Snapshot";
+    const QString data = "Data";
+    const QString dataSize = "DataSize";
+    const QString updated = "Updated";
+    const QString limit = "Limit";
+
+    // Data is either a full text encoded as Memo.Data is, or a delta when Snapshot is 0
+    QString sqlCreate() const override {
+        return "CREATE TABLE IF NOT EXISTS MemoHistory ("
+               "Id INTEGER PRIMARY KEY, "
+               "MemoId REFERENCES Memo(Id) ON DELETE CASCADE, "
+               "Moment, Station, Title, Snapshot, Data, DataSize)";
+    }
+
+    const QString sqlSelectMemo = "SELECT Title, Data, Updated, Station FROM Memo WHERE Id = :Id";
+    const QString sqlSelectMemoData = "SELECT Data FROM Memo WHERE Id = :Id";
+
+    const QString sqlSelectLastKinds =
+        "SELECT Snapshot FROM MemoHistory WHERE MemoId = :MemoId ORDER BY Id DESC LIMIT :Limit";
+
+    const QString sqlInsert =
+        "INSERT INTO MemoHistory (MemoId, Moment, Station, Title, Snapshot, Data, DataSize) "
+        "VALUES (:MemoId, :Moment, :Station, :Title, :Snapshot, :Data, :DataSize)";
+
+    const QString sqlSelectRevisions =
+        "SELECT Id, Moment, Title, DataSize FROM MemoHistory WHERE MemoId = :MemoId ORDER BY Id DESC";
+
+    // The revision and newer ones up to the nearest snapshot are needed to restore the revision
+    const QString sqlSelectChain =
+        "SELECT Id, Snapshot, Data FROM MemoHistory WHERE MemoId = :MemoId AND Id >= :Id ORDER BY Id";
+};
+
+HistoryTableDef* historyTable() { static HistoryTableDef t; return &t; }
+
+} // namespace
+
+//------------------------------------------------------------------------------
+//                              HistoryManager
+//------------------------------------------------------------------------------
+
+QString HistoryManager::prepare()
+{
+    auto table = historyTable();
+
+    QString res = createTable(table);
+    if (!res.isEmpty()) return res;
+
+    // The index also contains rowid, so revisions of a memo are ordered by it
+    return createIndexIfNotExist(table->tableName(), table->memoId);
+}
+
+QString HistoryManager::addRevision(int memoId, const MemoUpdateParam& update) const
+{
+    auto table = historyTable();
+
+    QString title, data;
+    QVariant moment, station;
+    {
+        SelectQuery query(table->sqlSelectMemo, {{ table->id, memoId }});
+        if (query.isFailed())
+            return QString("Unable to read memo #%1 for history.\n\n%2").arg(memoId).arg(query.error());
+
+        if (!query.next())
+            return QString("Memo #%1 does not exist.").arg(memoId);
+
+        auto r = query.record();
+        bool ok;
+        data = MemoManager::decodeData(r.value(table->data), &ok);
+        if (!ok)
+            return QString("Unable to store history of memo #%1, its data is corrupted.").arg(memoId);
+        title = r.value(table->title).toString();
+        moment = r.value(table->updated);
+        station = r.value(table->station);
+    }
+
+    // Nothing to remember when the memo is saved without changes
+    if (title == update.title && data == update.data) return QString();
+
+    int deltaCount = 0;
+    {
+        SelectQuery query(table->sqlSelectLastKinds, {{ table->memoId, memoId }, { table->limit, MAX_DELTA_CHAIN }});
+        if (query.isFailed())
+            return QString("Unable to read history of memo #%1.\n\n%2").arg(memoId).arg(query.error());
+
+        while (query.next() && !query.record().value(table->snapshot).toBool())
+            deltaCount++;
+    }
+
+    bool snapshot = deltaCount >= MAX_DELTA_CHAIN;
+    QVariant revisionData = MemoManager::encodeData(data);
+    if (!snapshot)
+    {
+        // The previous text is restored from the new one, so the new text is the delta source
+        QByteArray delta = TextDelta::make(update.data, data);
+
+        // When the text is mostly rewritten, storing it entirely is not bigger.
+        // Sizes are compared as they are stored, the text can be compressed.
+        int snapshotSize = revisionData.type() == QVariant::ByteArray
+                ? revisionData.toByteArray().size() : data.toUtf8().size();
+        if (delta.size() < snapshotSize)
+            revisionData = delta;
+        else snapshot = true;
+    }
+
+    QString res = ActionQuery(table->sqlInsert)
+            .param(table->memoId, memoId)
+            .param(table->moment, moment)
+            .param(table->station, station)
+            .param(table->title, title)
+            .param(table->snapshot, snapshot ? 1 : 0)
+            .param(table->data, revisionData)
+            .param(table->dataSize, data.size())
+            .exec();
+    if (!res.isEmpty())
+        return QString("Unable to store history of memo #%1.\n\n%2").arg(memoId).arg(res);
+    return QString();
+}
+
+MemoRevisionsResult HistoryManager::selectRevisions(int memoId) const
+{
+    MemoRevisionsResult result;
+    auto table = historyTable();
+
+    SelectQuery query(table->sqlSelectRevisions, {{ table->memoId, memoId }});
+    if (query.isFailed())
+    {
+        result.error = QString("Unable to load history of memo #%1.\n\n%2").arg(memoId).arg(query.error());
+        return result;
+    }
+
+    while (query.next())
+    {
+        auto r = query.record();
+        result.revisions.append({
+            r.value(table->id).toInt(),
+            r.value(table->moment).toDateTime(),
+            r.value(table->title).toString(),
+            r.value(table->dataSize).toLongLong()
+        });
+    }
+
+    return result;
+}
+
+/// Restores the text of the revision. Reading should be done in a transaction
+/// to not mix up the history with the memo text written by another connection.
+QString HistoryManager::selectRevisionData(int memoId, int revisionId, QString* data) const
+{
+    auto table = historyTable();
+
+    // Deltas from the requested revision to newer ones
+    QVector<QByteArray> deltas;
+    QString text;
+    bool hasText = false;
+    {
+        SelectQuery query(table->sqlSelectChain, {{ table->memoId, memoId }, { table->id, revisionId }});
+        if (query.isFailed())
+            return QString("Unable to load history of memo #%1.\n\n%2").arg(memoId).arg(query.error());
+
+        bool first = true;
+        while (query.next())
+        {
+            auto r = query.record();
+            if (first && r.value(table->id).toInt() != revisionId) break;
+            first = false;
+
+            if (r.value(table->snapshot).toBool())
+            {
+                bool ok;
+                text = MemoManager::decodeData(r.value(table->data), &ok);
+                if (!ok)
+                    return QString("History of memo #%1 is corrupted.").arg(memoId);
+                hasText = true;
+                break;
+            }
+            deltas.append(r.value(table->data).toByteArray());
+        }
+        if (first)
+            return QString("Revision #%1 of memo #%2 does not exist.").arg(revisionId).arg(memoId);
+    }
+
+    // There is no snapshot newer than the revision, deltas start from the current memo text
+    if (!hasText)
+    {
+        SelectQuery query(table->sqlSelectMemoData, {{ table->id, memoId }});
+        if (query.isFailed())
+            return QString("Unable to load memo #%1.\n\n%2").arg(memoId).arg(query.error());
+
+        if (!query.next())
+            return QString("Memo #%1 does not exist.").arg(memoId);
+
+        bool ok;
+        text = MemoManager::decodeData(query.record().value(table->data), &ok);
+        if (!ok)
+            return QString("Unable to load memo #%1, its data is corrupted.").arg(memoId);
+    }
+
+    for (int i = deltas.size() - 1; i >= 0; i--)
+    {
+        QString older;
+        if (!TextDelta::apply(text, deltas.at(i), older))
+            return QString("History of memo #%1 is damaged, revision #%2 can't be restored.").arg(memoId).arg(revisionId);
+        text = older;
+    }
+
+    *data = text;
+    return QString();
+}
@@ -0,0 +1,41 @@
+#ifndef HISTORY_MANAGER_H
+#define HISTORY_MANAGER_H
+
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+
+struct MemoUpdateParam;
+
+struct MemoRevision
+{
+    int id;
+    QDateTime moment;
+    QString title;
+    qint64 dataSize;
+};
+
+struct MemoRevisionsResult
+{
+    QString error;
+
+    // The newest revision goes first
+    QVector<MemoRevision> revisions;
+};
+
+/// Stores previous versions of memos. Each revision is kept as a delta
+/// turning the next newer version into this one, and every several revisions
+/// a full snapshot is stored to limit the number of deltas applied to restore a revision.
+class HistoryManager
+{
+public:
+    QString prepare();
+
+    /// Stores the current state of the memo as a revision, should be called before updating the memo.
+    QString addRevision(int memoId, const MemoUpdateParam& update) const;
+
+    MemoRevisionsResult selectRevisions(int memoId) const;
+    QString selectRevisionData(int memoId, int revisionId, QString* data) const;
+};
+
+#endif // HISTORY_MANAGER_H
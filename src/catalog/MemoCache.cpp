@@ -0,0 +1,85 @@
+#include "MemoCache.h"
+
+#include "Catalog.h"
+
+namespace {
+
+qint64 dataSize(MemoItem* item)
+{
+    return item->data().size() * qint64(sizeof(QChar));
+}
+
+} // namespace
+
+void MemoCache::setBudget(qint64 bytes)
+{
+    _budget = bytes;
+    evict();
+}
+
+void MemoCache::touch(MemoItem* item)
+{
+    auto it = _index.find(item->id());
+    if (it != _index.end())
+    {
+        _stats.bytes -= it.value()->bytes;
+        _entries.erase(it.value());
+    }
+
+    Entry entry { item, dataSize(item) };
+    _entries.push_front(entry);
+    _index[item->id()] = _entries.begin();
+    _stats.bytes += entry.bytes;
+    _stats.count = _index.size();
+
+    evict();
+}
+
+void MemoCache::remove(MemoItem* item)
+{
+    auto it = _index.find(item->id());
+    if (it == _index.end()) return;
+
+    _stats.bytes -= it.value()->bytes;
+    _entries.erase(it.value());
+    _index.erase(it);
+    _stats.count = _index.size();
+}
+
+void MemoCache::pin(int memoId)
+{
+    _pins[memoId]++;
+}
+
+void MemoCache::unpin(int memoId)
+{
+    auto it = _pins.find(memoId);
+    if (it == _pins.end()) return;
+
+    if (--it.value() <= 0)
+        _pins.erase(it);
+
+    evict();
+}
+
+void MemoCache::evict()
+{
+    if (_entries.empty()) return;
+
+    // The most recent memo is never evicted, it is being used right now
+    auto newest = _entries.begin();
+    auto it = _entries.end();
+    while (_stats.bytes > _budget && --it != newest)
+    {
+        if (_pins.contains(it->item->id()))
+            continue;
+
+        it->item->_data.clear();
+        it->item->_isLoaded = false;
+        _stats.bytes -= it->bytes;
+        _stats.evictions++;
+        _index.remove(it->item->id());
+        it = _entries.erase(it);
+    }
+    _stats.count = _index.size();
+}
@@ -0,0 +1,60 @@
+#ifndef MEMO_CACHE_H
+#define MEMO_CACHE_H
+
+#include <QHash>
+
+#include <list>
+
+class MemoItem;
+
+/// Keeps texts of recently used memos in memory within a byte budget.
+/// Texts of least recently used memos are unloaded when the budget is exceeded,
+/// and loaded again on demand. Memos opened in pages are pinned and never unloaded.
+class MemoCache
+{
+public:
+    struct Stats
+    {
+        int hits = 0;
+        int misses = 0;
+        int evictions = 0;
+        int count = 0;
+        qint64 bytes = 0;
+    };
+
+    qint64 budget() const { return _budget; }
+    void setBudget(qint64 bytes);
+
+    /// Registers usage of the memo. The memo text must be loaded.
+    void touch(MemoItem* item);
+
+    void countHit() { _stats.hits++; }
+    void countMiss() { _stats.misses++; }
+
+    /// Must be called when the memo is deleted.
+    void remove(MemoItem* item);
+
+    void pin(int memoId);
+    void unpin(int memoId);
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct Entry
+    {
+        MemoItem* item;
+        qint64 bytes;
+    };
+
+    qint64 _budget = 64 * 1024 * 1024;
+    Stats _stats;
+
+    // The most recently used memos are at the front
+    std::list<Entry> _entries;
+    QHash<int, std::list<Entry>::iterator> _index;
+    QHash<int, int> _pins;
+
+    void evict();
+};
+
+#endif // MEMO_CACHE_H
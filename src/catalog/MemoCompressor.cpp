@@ -0,0 +1,87 @@
+#include "MemoCompressor.h"
+
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QThread>
+
+namespace {
+
+// A portion is limited both by the number of memos and by their total size,
+// a few huge memos would hold the write lock for too long otherwise.
+const int COMPRESSION_BATCH_SIZE = 20;
+const qint64 COMPRESSION_BATCH_BYTES = 4 * 1024 * 1024;
+
+} // namespace
+
+//------------------------------------------------------------------------------
+//                              MemoCompressWorker
+//------------------------------------------------------------------------------
+
+MemoCompressWorker::MemoCompressWorker(const QString& fileName, int afterId, QAtomicInt* cancelled)
+    : StoreWorker(fileName), _afterId(afterId), _cancelled(cancelled)
+{
+}
+
+void MemoCompressWorker::started()
+{
+    if (!openError().isEmpty())
+    {
+        emit finished(openError());
+        return;
+    }
+
+    Ori::Sql::ConnectionGuard guard(connectionName());
+
+    while (!_cancelled->load())
+    {
+        int lastId = 0;
+        QString res = compressNext(&lastId);
+        if (!res.isEmpty())
+        {
+            emit finished(res);
+            return;
+        }
+        if (lastId == 0) break;
+
+        _afterId = lastId;
+        emit progress(lastId);
+    }
+    emit finished(QString());
+}
+
+QString MemoCompressWorker::compressNext(int* lastId)
+{
+    // Memos are read and written in one transaction, so the memo writer can't change them in between
+    QString res = CatalogStore::beginWriteTransaction();
+    if (!res.isEmpty()) return res;
+
+    res = CatalogStore::memoManager()->compressBatch(_afterId, COMPRESSION_BATCH_SIZE, COMPRESSION_BATCH_BYTES, lastId);
+    if (!res.isEmpty())
+    {
+        CatalogStore::rollbackTransaction();
+        return res;
+    }
+    return CatalogStore::commitTransaction();
+}
+
+//------------------------------------------------------------------------------
+//                                MemoCompressor
+//------------------------------------------------------------------------------
+
+MemoCompressor::MemoCompressor(const QString& fileName, int afterId, QObject* parent) : QObject(parent)
+{
+    auto worker = new MemoCompressWorker(fileName, afterId, &_cancelled);
+    _thread = StoreWorker::makeThread(worker, this);
+    connect(worker, &MemoCompressWorker::progress, this, &MemoCompressor::progress);
+    connect(worker, &MemoCompressWorker::finished, this, &MemoCompressor::finished);
+
+    _thread->start();
+}
+
+/// Stops compression after the current portion.
+MemoCompressor::~MemoCompressor()
+{
+    _cancelled.store(1);
+    StoreWorker::stopThread(_thread);
+}
@@ -0,0 +1,63 @@
+#ifndef MEMO_COMPRESSOR_H
+#define MEMO_COMPRESSOR_H
+
+#include "StoreWorker.h"
+
+#include <QAtomicInt>
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+//------------------------------------------------------------------------------
+
+/// Compresses memos in a worker thread using its own connection.
+/// Memos are processed in small transactions, so the write lock is held only for a short time
+/// and memos saved meanwhile don't have to wait until the whole pass is done.
+class MemoCompressWorker : public StoreWorker
+{
+    Q_OBJECT
+
+public:
+    MemoCompressWorker(const QString& fileName, int afterId, QAtomicInt* cancelled);
+
+signals:
+    void progress(int lastId);
+    void finished(const QString& error);
+
+protected:
+    void started() override;
+
+private:
+    int _afterId;
+    QAtomicInt* _cancelled;
+
+    QString compressNext(int* lastId);
+};
+
+//------------------------------------------------------------------------------
+
+/// Compresses memos that were stored as plain text by previous program versions
+/// without blocking the GUI thread. The pass starts right away and is cancelled when the compressor is deleted.
+class MemoCompressor : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// Memos having ids greater than `afterId` are processed.
+    MemoCompressor(const QString& fileName, int afterId, QObject* parent = nullptr);
+    ~MemoCompressor() override;
+
+signals:
+    /// Emitted after each portion, memos up to `lastId` are processed.
+    void progress(int lastId);
+    /// Emitted when all memos are processed, the error is empty on success.
+    void finished(const QString& error);
+
+private:
+    QThread* _thread;
+    QAtomicInt _cancelled;
+};
+
+#endif // MEMO_COMPRESSOR_H
@@ -1,6 +1,8 @@
 #include "MemoManager.h"
 
 #include "Catalog.h"
+#include "CatalogStats.h"
+#include "ChunkStore.h"
 #include "SqlHelper.h"
 
 using namespace Ori::Sql;
@@ -11,6 +13,25 @@ using namespace Ori::Sql;
 
 namespace {
 
+// Compressed memo text is stored as BLOB starting with this marker, plain text is stored as TEXT.
+// The digit is format version, it allows to change compression method later.
+const QByteArray COMPRESSED_DATA_MARKER("PZ1:");
+
+// Smaller texts are stored as is, compression does not give much for them
+const int COMPRESSION_THRESHOLD = 1024;
+
+// Number of ids in one `WHERE Id IN (...)` query. It's fixed so there is only
+// one prepared statement for any number of requested memos, missing ids are padded.
+const int DATA_BATCH_SIZE = 32;
+
+QString makeIdPlaceholders(const QString& name, int count)
+{
+    QStringList placeholders;
+    for (int i = 0; i < count; i++)
+        placeholders << ':' + name + QString::number(i);
+    return placeholders.join(", ");
+}
+
 class MemoTableDef : public Ori::Sql::TableDef
 {
 public:
@@ -21,30 +42,82 @@ public:
     const QString title = "Title";
     const QString type = "Type";
     const QString data = "Data";
+    const QString dataSize = "DataSize";
     const QString created = "Created";
     const QString updated = "Updated";
     const QString station = "Station";
+    const QString limit = "Limit";
+    const QString minSize = "MinSize";
 
     QString sqlCreate() const override {
         return "CREATE TABLE IF NOT EXISTS Memo ("
                "Id INTEGER PRIMARY KEY, "
                "Parent REFERENCES Folder(Id) ON DELETE CASCADE, "
-               "Title, Type, Data, Created, Updated, Station)";
+               "Title, Type, Data, Created, Updated, Station, DataSize)";
     }
 
+    // Statistics are calculated from this index only, without reading the table
+    const QString sqlCreateStatsIndex =
+        "CREATE INDEX IF NOT EXISTS Memo_Stats ON Memo (Parent, Type, DataSize)";
+
+    // The index is created when sizes are filled, so it marks that filling is done
+    const QString sqlCheckStatsIndex =
+        "SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = 'Memo_Stats'";
+
+    const QString sqlSelectStats =
+        "SELECT Parent, Type, COUNT(*), SUM(DataSize) FROM Memo GROUP BY Parent, Type";
+
+    const QString sqlSelectDataSizeById = "SELECT DataSize FROM Memo WHERE Id = :Id";
+
+    // Memos stored by previous program versions don't know their sizes
+    const QString sqlFillTextDataSizes =
+        "UPDATE Memo SET DataSize = ifnull(length(Data), 0) "
+        "WHERE DataSize IS NULL AND typeof(Data) <> 'blob'";
+    const QString sqlSelectBlobsWithoutSize =
+        "SELECT Id, Data FROM Memo WHERE DataSize IS NULL";
+    const QString sqlUpdateDataSize = "UPDATE Memo SET DataSize = :DataSize WHERE Id = :Id";
+
     const QString sqlSelectAllNoData =
         "SELECT Id, Parent, Title, Type, Created, Updated, Station FROM Memo";
 
-    virtual QString sqlSelectDataById(int id) const {
-        return QString("SELECT Data FROM Memo WHERE Id = %1").arg(id);
-    }
+    const QString sqlSelectByParentNoData = sqlSelectAllNoData + " WHERE Parent = :Parent";
+    const QString sqlSelectTopLevelNoData = sqlSelectAllNoData + " WHERE Parent IS NULL OR Parent = 0";
 
+    // Keyset pagination, it doesn't slow down on far pages as OFFSET does
+    const QString sqlSelectBatchNoData = sqlSelectAllNoData + " WHERE Id > :Id ORDER BY Id LIMIT :Limit";
+
+    const QString sqlSelectParentById = "SELECT Parent FROM Memo WHERE Id = :Id";
+
+    // Subfolders of a folder whose content is not loaded yet are unknown to the catalog
+    const QString sqlSelectIdsInBranch =
+        "WITH RECURSIVE Branch(Id) AS ("
+            "SELECT :Parent "
+            "UNION ALL "
+            "SELECT Folder.Id FROM Folder JOIN Branch ON Folder.Parent = Branch.Id) "
+        "SELECT Id FROM Memo WHERE Parent IN Branch";
+    const QString sqlSelectDataById = "SELECT Data FROM Memo WHERE Id = :Id";
+    const QString sqlSelectDataByIds =
+        "SELECT Id, Data, Updated FROM Memo WHERE Id IN (" + makeIdPlaceholders(id, DATA_BATCH_SIZE) + ")";
+
+    // Memos stored as plain text by previous program versions,
+    // length() of text counts characters, so the text is cast to BLOB to count bytes
+    const QString sqlSelectUncompressed =
+        "SELECT Id, Data FROM Memo WHERE Id > :Id AND typeof(Data) = 'text' "
+        "AND length(CAST(Data AS BLOB)) >= :MinSize ORDER BY Id LIMIT :Limit";
+
+    const QString sqlUpdateData = "UPDATE Memo SET Data = :Data WHERE Id = :Id";
+
+    // Id is generated by database, it is an alias for rowid
     const QString sqlInsert =
-        "INSERT INTO Memo (Id, Parent, Title, Type, Data, Created, Updated, Station) "
-        "VALUES (:Id, :Parent, :Title, :Type, :Data, :Created, :Updated, :Station)";
+        "INSERT INTO Memo (Parent, Title, Type, Data, DataSize, Created, Updated, Station) "
+        "VALUES (:Parent, :Title, :Type, :Data, :DataSize, :Created, :Updated, :Station)";
+
+    const QString sqlSavepointStore = "SAVEPOINT StoreMemo";
+    const QString sqlReleaseStore = "RELEASE StoreMemo";
+    const QString sqlRollbackToStore = "ROLLBACK TO StoreMemo";
 
     const QString sqlUpdate =
-        "UPDATE Memo SET Title = :Title, Data = :Data, Updated = :Updated, Station = :Station "
+        "UPDATE Memo SET Title = :Title, Data = :Data, DataSize = :DataSize, Updated = :Updated, Station = :Station "
         "WHERE Id = :Id";
 
     const QString sqlDelete = "DELETE FROM Memo WHERE Id = :Id";
@@ -65,17 +138,48 @@ public:
                "Name, Value)";
     }
 
-    const QString sqlSelect(int memoId) const {
-        return QString("SELECT Name, Value from MemoOptions WHERE MemoId = %1").arg(memoId);
-    }
+    const QString sqlSelect = "SELECT Name, Value from MemoOptions WHERE MemoId = :MemoId";
+    const QString sqlSelectAll = "SELECT MemoId, Name, Value from MemoOptions";
 
+    // REPLACE needs an unique index, without it each option change added a new row
     const QString sqlUpdate =
         "REPLACE INTO MemoOptions (MemoId, Name, Value) VALUES (:MemoId, :Name, :Value)";
+
+    const QString uniqueIndexName = "MemoOptions_MemoId_Name";
+    const QString sqlCheckUniqueIndex =
+        "SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = '" + uniqueIndexName + "'";
+    const QString sqlCreateUniqueIndex =
+        "CREATE UNIQUE INDEX IF NOT EXISTS " + uniqueIndexName + " ON MemoOptions (MemoId, Name)";
+
+    // The last written row is the effective value, as it was read last by previous program versions
+    const QString sqlDeleteDuplicates =
+        "DELETE FROM MemoOptions WHERE rowid NOT IN "
+        "(SELECT MAX(rowid) FROM MemoOptions GROUP BY MemoId, Name)";
 };
 
 MemoTableDef* memoTable() { static MemoTableDef t; return &t; }
 MemoOptionsTableDef* memoOptionsTable() { static MemoOptionsTableDef t; return &t; }
 
+// Memo row and references to its chunks are written together or not at all,
+// the savepoint works both inside and outside of a transaction.
+template <typename Operation> QString inSavepoint(Operation operation)
+{
+    auto table = memoTable();
+
+    QString res = ActionQuery(table->sqlSavepointStore).exec();
+    if (!res.isEmpty()) return res;
+
+    res = operation();
+    if (!res.isEmpty())
+    {
+        ActionQuery(table->sqlRollbackToStore).exec();
+        ActionQuery(table->sqlReleaseStore).exec();
+        return res;
+    }
+
+    return ActionQuery(table->sqlReleaseStore).exec();
+}
+
 } // namespace
 
 //------------------------------------------------------------------------------
@@ -98,43 +202,199 @@ QString MemoManager::prepare()
     res = addColumnIfNotExist(table->tableName(), table->station);
     if (!res.isEmpty()) return res;
 
-    return createTable(memoOptionsTable());
+    res = addColumnIfNotExist(table->tableName(), table->dataSize);
+    if (!res.isEmpty()) return res;
+
+    res = createIndexIfNotExist(table->tableName(), table->parent);
+    if (!res.isEmpty()) return res;
+
+    // Filling reads each memo, so it's done only once, when the statistics index is introduced
+    bool hasStatsIndex;
+    {
+        SelectQuery query(table->sqlCheckStatsIndex);
+        if (query.isFailed())
+            return QString("Unable to check indexes of memos.\n\n%1").arg(query.error());
+        hasStatsIndex = query.next();
+    }
+    if (!hasStatsIndex)
+    {
+        res = fillDataSizes();
+        if (!res.isEmpty()) return res;
+
+        res = ActionQuery(table->sqlCreateStatsIndex).exec();
+        if (!res.isEmpty())
+            return QString("Unable to create statistics index.\n\n%1").arg(res);
+    }
+
+    res = ChunkStore::prepare();
+    if (!res.isEmpty()) return res;
+
+    res = createTable(memoOptionsTable());
+    if (!res.isEmpty()) return res;
+
+    return prepareOptions();
 }
 
-QString MemoManager::create(MemoItem* item) const
+QString MemoManager::prepareOptions() const
+{
+    auto table = memoOptionsTable();
+
+    bool hasIndex;
+    {
+        SelectQuery query(table->sqlCheckUniqueIndex);
+        if (query.isFailed())
+            return QString("Unable to check indexes of memo options.\n\n%1").arg(query.error());
+        hasIndex = query.next();
+    }
+    if (hasIndex) return QString();
+
+    QString res = ActionQuery(table->sqlDeleteDuplicates).exec();
+    if (!res.isEmpty())
+        return QString("Unable to remove duplicated memo options.\n\n%1").arg(res);
+
+    res = ActionQuery(table->sqlCreateUniqueIndex).exec();
+    if (!res.isEmpty())
+        return QString("Unable to create index for memo options.\n\n%1").arg(res);
+
+    return QString();
+}
+
+QString MemoManager::fillDataSizes() const
 {
     auto table = memoTable();
 
-    SelectQuery queryId(table->sqlSelectMaxId());
-    if (queryId.isFailed() || !queryId.next())
-        return QString("Unable to generate id for new memo.\n\n%1").arg(queryId.error());
+    QString res = ActionQuery(table->sqlFillTextDataSizes).exec();
+    if (!res.isEmpty())
+        return QString("Unable to calculate sizes of memos.\n\n%1").arg(res);
 
-    int newId = queryId.record().value(0).toInt() + 1;
-    item->_id = newId;
+    // Only compressed texts are left, they have to be decompressed to know their sizes
+    QList<QPair<int, qint64>> sizes;
+    {
+        SelectQuery query(table->sqlSelectBlobsWithoutSize);
+        if (query.isFailed())
+            return QString("Unable to calculate sizes of memos.\n\n%1").arg(query.error());
+
+        while (query.next())
+        {
+            auto r = query.record();
+            sizes.append({ r.value(0).toInt(), decodeData(r.value(1)).size() });
+        }
+    }
+    for (auto size : sizes)
+    {
+        res = ActionQuery(table->sqlUpdateDataSize)
+                .param(table->id, size.first)
+                .param(table->dataSize, size.second)
+                .exec();
+        if (!res.isEmpty())
+            return QString("Unable to store size of memo #%1.\n\n%2").arg(size.first).arg(res);
+    }
+    return QString();
+}
 
-    auto res = ActionQuery(table->sqlInsert)
-            .param(table->parent, item->parent() ? item->parent()->asFolder()->id() : 0)
-            .param(table->id, item->id())
-            .param(table->title, item->title())
-            .param(table->type, item->type()->name())
-            .param(table->data, item->data())
-            .param(table->created, item->created())
-            .param(table->updated, item->updated())
-            .param(table->station, item->station())
-            .exec();
+/// Makes a value of Data column. Big texts are stored as references to chunks shared
+/// between memos, the chunks must be attached to the memo when it is written.
+QString MemoManager::storeData(const QString& data, QVariant* value, QVector<int>* chunkIds) const
+{
+    chunkIds->clear();
+    if (!ChunkStore::isChunkable(data))
+    {
+        *value = encodeData(data);
+        return QString();
+    }
+
+    QString res = ChunkStore::write(data, chunkIds);
+    if (!res.isEmpty()) return res;
+
+    *value = ChunkStore::makeRef(*chunkIds);
+    return QString();
+}
+
+QString MemoManager::create(MemoItem* item) const
+{
+    auto table = memoTable();
+
+    auto res = inSavepoint([&]() -> QString {
+        QVariant data;
+        QVector<int> chunkIds;
+        QString res = storeData(item->data(), &data, &chunkIds);
+        if (!res.isEmpty()) return res;
+
+        ActionQuery query(table->sqlInsert);
+        res = query
+                .param(table->parent, item->parent() ? item->parent()->asFolder()->id() : 0)
+                .param(table->title, item->title())
+                .param(table->type, item->type()->name())
+                .param(table->data, data)
+                .param(table->dataSize, item->data().size())
+                .param(table->created, item->created())
+                .param(table->updated, item->updated())
+                .param(table->station, item->station())
+                .exec();
+        if (!res.isEmpty()) return res;
+
+        item->_id = query.lastInsertId().toInt();
+        if (chunkIds.isEmpty()) return QString();
+        return ChunkStore::attach(item->id(), chunkIds);
+    });
     if (!res.isEmpty())
         return QString("Failed to create new memo.\n\n%1").arg(res);
-
     return QString();
 }
 
 MemosResult MemoManager::selectAll() const
+{
+    return selectMemos(memoTable()->sqlSelectAllNoData);
+}
+
+MemosResult MemoManager::selectChildren(int parentId) const
+{
+    auto table = memoTable();
+    if (parentId > 0)
+        return selectMemos(table->sqlSelectByParentNoData, {{ table->parent, parentId }});
+    return selectMemos(table->sqlSelectTopLevelNoData);
+}
+
+MemosResult MemoManager::selectBatch(int afterId, int limit) const
+{
+    auto table = memoTable();
+    return selectMemos(table->sqlSelectBatchNoData, {{ table->id, afterId }, { table->limit, limit }});
+}
+
+QString MemoManager::selectParentId(int memoId, int* parentId) const
+{
+    auto table = memoTable();
+    SelectQuery query(table->sqlSelectParentById, {{ table->id, memoId }});
+    if (query.isFailed())
+        return QString("Unable to get folder of memo #%1.\n\n%2").arg(memoId).arg(query.error());
+
+    if (!query.next())
+        return QString("Memo #%1 does not exist.").arg(memoId);
+
+    *parentId = query.record().value(0).toInt();
+    return QString();
+}
+
+/// Returns ids of memos of the folder and of all its subfolders.
+QString MemoManager::selectIdsInBranch(int folderId, QVector<int>* ids) const
+{
+    auto table = memoTable();
+    SelectQuery query(table->sqlSelectIdsInBranch, {{ table->parent, folderId }});
+    if (query.isFailed())
+        return QString("Unable to get memos of folder #%1.\n\n%2").arg(folderId).arg(query.error());
+
+    while (query.next())
+        ids->append(query.record().value(table->id).toInt());
+    return QString();
+}
+
+MemosResult MemoManager::selectMemos(const QString& sql, const QMap<QString, QVariant>& params) const
 {
     auto table = memoTable();
 
     MemosResult result;
 
-    SelectQuery query(table->sqlSelectAllNoData);
+    SelectQuery query(sql, params);
     if (query.isFailed())
     {
         result.error = QString("Unable to load memos.\n\n%1").arg(query.error());
@@ -167,7 +427,7 @@ QString MemoManager::load(MemoItem* memo) const
 {
     auto table = memoTable();
 
-    SelectQuery query(table->sqlSelectDataById(memo->id()));
+    SelectQuery query(table->sqlSelectDataById, {{ table->id, memo->id() }});
     if (query.isFailed())
         return QString("Unable to load memo #%1.\n\n%2").arg(memo->id()).arg(query.error());
 
@@ -175,21 +435,77 @@ QString MemoManager::load(MemoItem* memo) const
         return QString("Memo #%1 does not exist.").arg(memo->id());
 
     QSqlRecord r = query.record();
-    memo->_data = r.value(table->data).toString();
+    bool ok;
+    QString data = decodeData(r.value(table->data), &ok);
+    if (!ok)
+        return QString("Unable to load memo #%1, its data is corrupted.").arg(memo->id());
+
+    memo->_data = data;
     memo->_isLoaded = true;
     return QString();
 }
 
-QString MemoManager::update(MemoItem* memo, const MemoUpdateParam& update) const
+MemoDataResult MemoManager::selectData(const QList<int>& ids) const
 {
+    MemoDataResult result;
+
     auto table = memoTable();
-    return ActionQuery(table->sqlUpdate)
-            .param(table->id, memo->id())
-            .param(table->title, update.title)
-            .param(table->data, update.data)
-            .param(table->updated, update.moment)
-            .param(table->station, update.station)
-            .exec();
+
+    for (int start = 0; start < ids.size(); start += DATA_BATCH_SIZE)
+    {
+        QMap<QString, QVariant> params;
+        for (int i = 0; i < DATA_BATCH_SIZE; i++)
+        {
+            int index = start + i;
+            params[table->id + QString::number(i)] = index < ids.size() ? ids.at(index) : -1;
+        }
+
+        SelectQuery query(table->sqlSelectDataByIds, params);
+        if (query.isFailed())
+        {
+            result.error = QString("Unable to load memos.\n\n%1").arg(query.error());
+            return result;
+        }
+
+        while (query.next())
+        {
+            QSqlRecord r = query.record();
+            bool ok;
+            QString data = decodeData(r.value(table->data), &ok);
+            // Corrupted memo is left unloaded, the error is reported when it's opened
+            if (!ok) continue;
+
+            int id = r.value(table->id).toInt();
+            result.data.insert(id, data);
+            result.updated.insert(id, r.value(table->updated).toDateTime());
+        }
+    }
+
+    return result;
+}
+
+QString MemoManager::update(int memoId, const MemoUpdateParam& update) const
+{
+    auto table = memoTable();
+    return inSavepoint([&]() -> QString {
+        QVariant data;
+        QVector<int> chunkIds;
+        QString res = storeData(update.data, &data, &chunkIds);
+        if (!res.isEmpty()) return res;
+
+        res = ActionQuery(table->sqlUpdate)
+                .param(table->id, memoId)
+                .param(table->title, update.title)
+                .param(table->data, data)
+                .param(table->dataSize, update.data.size())
+                .param(table->updated, update.moment)
+                .param(table->station, update.station)
+                .exec();
+        if (!res.isEmpty()) return res;
+
+        // Chunks of the previous text are released even if the new text is not chunked
+        return ChunkStore::attach(memoId, chunkIds);
+    });
 }
 
 QString MemoManager::remove(MemoItem* item) const
@@ -211,12 +527,42 @@ QString MemoManager::countAll(int *count) const
     return QString();
 }
 
+QString MemoManager::selectStats(CatalogStats* stats) const
+{
+    auto table = memoTable();
+    SelectQuery query(table->sqlSelectStats);
+    if (query.isFailed())
+        return QString("Unable to calculate notebook statistics.\n\n%1").arg(query.error());
+
+    stats->clear();
+    while (query.next())
+    {
+        auto r = query.record();
+        stats->addMemos(r.value(0).toInt(), r.value(1).toString(), r.value(2).toInt(), r.value(3).toLongLong());
+    }
+    return QString();
+}
+
+QString MemoManager::selectDataSize(int memoId, qint64* size) const
+{
+    auto table = memoTable();
+    SelectQuery query(table->sqlSelectDataSizeById, {{ table->id, memoId }});
+    if (query.isFailed())
+        return QString("Unable to get size of memo #%1.\n\n%2").arg(memoId).arg(query.error());
+
+    if (!query.next())
+        return QString("Memo #%1 does not exist.").arg(memoId);
+
+    *size = query.record().value(0).toLongLong();
+    return QString();
+}
+
 QMap<QString, QVariant> MemoManager::selectOptions(int memoId) const
 {
     QMap<QString, QVariant> options;
     auto table = memoOptionsTable();
 
-    SelectQuery query(table->sqlSelect(memoId));
+    SelectQuery query(table->sqlSelect, {{ table->memoId, memoId }});
     if (query.isFailed())
     {
         qWarning() << "Unable to select options for memo" << memoId << query.error();
@@ -232,6 +578,123 @@ QMap<QString, QVariant> MemoManager::selectOptions(int memoId) const
     return options;
 }
 
+MemoOptionsResult MemoManager::selectAllOptions() const
+{
+    MemoOptionsResult result;
+    auto table = memoOptionsTable();
+
+    SelectQuery query(table->sqlSelectAll);
+    if (query.isFailed())
+    {
+        result.error = QString("Unable to load memo options.\n\n%1").arg(query.error());
+        return result;
+    }
+
+    while (query.next())
+    {
+        auto r = query.record();
+        result.options[r.value(table->memoId).toInt()][r.value(table->name).toString()] = r.value(table->value);
+    }
+
+    return result;
+}
+
+QVariant MemoManager::encodeData(const QString& data)
+{
+    QByteArray utf8 = data.toUtf8();
+    if (utf8.size() < COMPRESSION_THRESHOLD)
+        return data;
+
+    QByteArray compressed = qCompress(utf8);
+    if (compressed.size() + COMPRESSED_DATA_MARKER.size() >= utf8.size())
+        return data;
+
+    return COMPRESSED_DATA_MARKER + compressed;
+}
+
+QString MemoManager::decodeData(const QVariant& value, bool* ok)
+{
+    if (ok) *ok = true;
+
+    if (value.type() != QVariant::ByteArray)
+        return value.toString();
+
+    QByteArray bytes = value.toByteArray();
+    if (ChunkStore::isRef(bytes))
+    {
+        QString data;
+        QString res = ChunkStore::read(bytes, &data);
+        if (!res.isEmpty())
+        {
+            qWarning() << res;
+            if (ok) *ok = false;
+        }
+        return data;
+    }
+
+    if (!bytes.startsWith(COMPRESSED_DATA_MARKER))
+        return QString::fromUtf8(bytes);
+
+    QByteArray utf8 = qUncompress(bytes.mid(COMPRESSED_DATA_MARKER.size()));
+    if (utf8.isEmpty() && ok)
+        *ok = false;
+    return QString::fromUtf8(utf8);
+}
+
+/// Compresses memos that were stored as plain text by previous program versions.
+/// Memos having ids greater than `afterId` are processed until `limit` memos or `maxBytes` of text are done.
+/// The last processed id is returned in `lastId`, it is 0 when there are no more memos to process.
+QString MemoManager::compressBatch(int afterId, int limit, qint64 maxBytes, int* lastId) const
+{
+    auto table = memoTable();
+
+    QVector<QPair<int, QString>> memos;
+    {
+        SelectQuery query(table->sqlSelectUncompressed, {
+            { table->id, afterId },
+            { table->minSize, COMPRESSION_THRESHOLD },
+            { table->limit, limit }
+        });
+        if (query.isFailed())
+            return QString("Unable to select memos for compression.\n\n%1").arg(query.error());
+
+        while (query.next())
+        {
+            auto r = query.record();
+            memos.append({ r.value(table->id).toInt(), r.value(table->data).toString() });
+        }
+    }
+
+    *lastId = 0;
+    qint64 bytes = 0;
+    for (auto& memo : memos)
+    {
+        if (bytes >= maxBytes) break;
+
+        // Text can be still stored as is if compression does not make it smaller,
+        // big texts are split into chunks to share them with other memos.
+        auto res = inSavepoint([&]() -> QString {
+            QVariant data;
+            QVector<int> chunkIds;
+            QString res = storeData(memo.second, &data, &chunkIds);
+            if (!res.isEmpty() || data.type() != QVariant::ByteArray) return res;
+
+            res = ActionQuery(table->sqlUpdateData)
+                    .param(table->id, memo.first)
+                    .param(table->data, data)
+                    .exec();
+            if (!res.isEmpty() || chunkIds.isEmpty()) return res;
+
+            return ChunkStore::attach(memo.first, chunkIds);
+        });
+        if (!res.isEmpty())
+            return QString("Unable to compress memo #%1.\n\n%2").arg(memo.first).arg(res);
+        *lastId = memo.first;
+        bytes += memo.second.size() * int(sizeof(QChar));
+    }
+    return QString();
+}
+
 QString MemoManager::updateOption(int memoId, const QString& name, const QVariant& value) const
 {
     auto table = memoOptionsTable();
@@ -1,10 +1,14 @@
 #ifndef MEMO_MANAGER_H
 #define MEMO_MANAGER_H
 
+#include <QDateTime>
+#include <QHash>
 #include <QString>
 #include <QMap>
 #include <QVariant>
+#include <QVector>
 
+class CatalogStats;
 class MemoItem;
 struct MemoUpdateParam;
 
@@ -20,19 +24,58 @@ struct MemosResult
     QMap<int, MemoItem*> allMemos;
 };
 
+struct MemoDataResult
+{
+    QString error;
+
+    // memoId -> memo text
+    QMap<int, QString> data;
+
+    // memoId -> time when the text was last changed
+    QMap<int, QDateTime> updated;
+};
+
+struct MemoOptionsResult
+{
+    QString error;
+
+    // memoId -> [optionName -> optionValue]
+    QHash<int, QMap<QString, QVariant>> options;
+};
+
 class MemoManager
 {
 public:
     QString prepare();
 
     QString create(MemoItem* item) const;
-    QString update(MemoItem *item, const MemoUpdateParam& update) const;
+    QString update(int memoId, const MemoUpdateParam& update) const;
     QString remove(MemoItem* item) const;
     QString load(MemoItem *memo) const;
+    MemoDataResult selectData(const QList<int>& ids) const;
     MemosResult selectAll() const;
+    MemosResult selectChildren(int parentId) const;
+    MemosResult selectBatch(int afterId, int limit) const;
+    QString selectParentId(int memoId, int* parentId) const;
+    QString selectIdsInBranch(int folderId, QVector<int>* ids) const;
     QString countAll(int* count) const;
+    QString selectStats(CatalogStats* stats) const;
+    QString selectDataSize(int memoId, qint64* size) const;
     QMap<QString, QVariant> selectOptions(int memoId) const;
+    MemoOptionsResult selectAllOptions() const;
     QString updateOption(int memoId, const QString& name, const QVariant& value) const;
+    QString compressBatch(int afterId, int limit, qint64 maxBytes, int* lastId) const;
+
+    /// Memo text is stored compressed when it's big enough,
+    /// these functions convert it into a value of Data column and back.
+    static QVariant encodeData(const QString& data);
+    static QString decodeData(const QVariant& value, bool* ok = nullptr);
+
+private:
+    QString storeData(const QString& data, QVariant* value, QVector<int>* chunkIds) const;
+    QString fillDataSizes() const;
+    QString prepareOptions() const;
+    MemosResult selectMemos(const QString& sql, const QMap<QString, QVariant>& params = QMap<QString, QVariant>()) const;
 };
 
 #endif // MEMO_MANAGER_H
@@ -0,0 +1,54 @@
+#include "MemoPrefetcher.h"
+
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QThread>
+
+//------------------------------------------------------------------------------
+//                              MemoPrefetchWorker
+//------------------------------------------------------------------------------
+
+MemoPrefetchWorker::MemoPrefetchWorker(const QString& fileName) : StoreWorker(fileName)
+{
+}
+
+void MemoPrefetchWorker::prefetch(const QList<int>& ids)
+{
+    if (!openError().isEmpty())
+    {
+        MemoDataResult result;
+        result.error = openError();
+        emit prefetched(ids, result);
+        return;
+    }
+
+    Ori::Sql::ConnectionGuard guard(connectionName());
+    emit prefetched(ids, CatalogStore::memoManager()->selectData(ids));
+}
+
+//------------------------------------------------------------------------------
+//                                MemoPrefetcher
+//------------------------------------------------------------------------------
+
+MemoPrefetcher::MemoPrefetcher(const QString& fileName, QObject* parent) : QObject(parent)
+{
+    qRegisterMetaType<MemoDataResult>();
+
+    auto worker = new MemoPrefetchWorker(fileName);
+    _thread = StoreWorker::makeThread(worker, this);
+    connect(this, &MemoPrefetcher::prefetchRequested, worker, &MemoPrefetchWorker::prefetch);
+    connect(worker, &MemoPrefetchWorker::prefetched, this, &MemoPrefetcher::prefetched);
+
+    _thread->start();
+}
+
+MemoPrefetcher::~MemoPrefetcher()
+{
+    StoreWorker::stopThread(_thread);
+}
+
+void MemoPrefetcher::prefetch(const QList<int>& ids)
+{
+    emit prefetchRequested(ids);
+}
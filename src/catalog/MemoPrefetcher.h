@@ -0,0 +1,56 @@
+#ifndef MEMO_PREFETCHER_H
+#define MEMO_PREFETCHER_H
+
+#include "MemoManager.h"
+#include "StoreWorker.h"
+
+#include <QMetaType>
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+Q_DECLARE_METATYPE(MemoDataResult)
+
+//------------------------------------------------------------------------------
+
+/// Reads memo texts in a worker thread using its own connection.
+class MemoPrefetchWorker : public StoreWorker
+{
+    Q_OBJECT
+
+public:
+    explicit MemoPrefetchWorker(const QString& fileName);
+
+    void prefetch(const QList<int>& ids);
+
+signals:
+    void prefetched(const QList<int>& ids, const MemoDataResult& result);
+};
+
+//------------------------------------------------------------------------------
+
+/// Loads texts of memos which are likely to be opened soon without blocking the GUI thread.
+/// Requests are processed one by one in the same worker thread that lives while the prefetcher exists.
+class MemoPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MemoPrefetcher(const QString& fileName, QObject* parent = nullptr);
+    ~MemoPrefetcher() override;
+
+    void prefetch(const QList<int>& ids);
+
+signals:
+    void prefetched(const QList<int>& ids, const MemoDataResult& result);
+
+    /// Passes a request to the worker thread, it is not intended to be used outside.
+    void prefetchRequested(const QList<int>& ids);
+
+private:
+    QThread* _thread;
+};
+
+#endif // MEMO_PREFETCHER_H
@@ -0,0 +1,100 @@
+#include "MemoWriter.h"
+
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThread>
+#include <QTimer>
+
+//------------------------------------------------------------------------------
+//                              MemoWriterWorker
+//------------------------------------------------------------------------------
+
+MemoWriterWorker::MemoWriterWorker(const QString& fileName) : StoreWorker(fileName)
+{
+}
+
+void MemoWriterWorker::finishing()
+{
+    // The event loop is already stopped, but requests queued before
+    // stopping must not be lost, so they are delivered explicitly
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    writePending();
+}
+
+void MemoWriterWorker::save(int memoId, const MemoUpdateParam& update)
+{
+    // Requests already queued are processed before writing,
+    // so only the last change of a memo is written when they come quickly
+    if (_pending.isEmpty())
+        QTimer::singleShot(0, this, &MemoWriterWorker::writePending);
+
+    _pending[memoId] = update;
+}
+
+void MemoWriterWorker::writePending()
+{
+    auto pending = _pending;
+    _pending.clear();
+
+    for (auto it = pending.constBegin(); it != pending.constEnd(); it++)
+        emit saved(it.key(), it.value().moment, write(it.key(), it.value()));
+}
+
+QString MemoWriterWorker::write(int memoId, const MemoUpdateParam& update)
+{
+    if (!openError().isEmpty()) return openError();
+
+    Ori::Sql::ConnectionGuard guard(connectionName());
+
+    // The transaction reads history before writing, so it must take the write lock at once.
+    // Otherwise it fails when the main connection is writing at the same time.
+    QString res = CatalogStore::beginWriteTransaction();
+    if (!res.isEmpty()) return res;
+
+    // The previous text goes to history in the same transaction, so the history always matches the memo
+    res = CatalogStore::historyManager()->addRevision(memoId, update);
+    if (res.isEmpty())
+        res = CatalogStore::memoManager()->update(memoId, update);
+    if (!res.isEmpty())
+    {
+        CatalogStore::rollbackTransaction();
+        return res;
+    }
+
+    // The search index is derived data, failing to update it should not fail the memo saving
+    QString indexRes = CatalogStore::searchManager()->updateIndex(memoId, update.title, update.data);
+    if (!indexRes.isEmpty())
+        qWarning() << "Failed to update search index for memo" << memoId << indexRes;
+
+    return CatalogStore::commitTransaction();
+}
+
+//------------------------------------------------------------------------------
+//                                 MemoWriter
+//------------------------------------------------------------------------------
+
+MemoWriter::MemoWriter(const QString& fileName, QObject* parent) : QObject(parent)
+{
+    qRegisterMetaType<MemoUpdateParam>();
+
+    auto worker = new MemoWriterWorker(fileName);
+    _thread = StoreWorker::makeThread(worker, this);
+    connect(this, &MemoWriter::saveRequested, worker, &MemoWriterWorker::save);
+    connect(worker, &MemoWriterWorker::saved, this, &MemoWriter::saved);
+
+    _thread->start();
+}
+
+/// Waits until all changes are written.
+MemoWriter::~MemoWriter()
+{
+    StoreWorker::stopThread(_thread);
+}
+
+void MemoWriter::save(int memoId, const MemoUpdateParam& update)
+{
+    emit saveRequested(memoId, update);
+}
@@ -0,0 +1,68 @@
+#ifndef MEMO_WRITER_H
+#define MEMO_WRITER_H
+
+#include "Catalog.h"
+#include "StoreWorker.h"
+
+#include <QMetaType>
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+Q_DECLARE_METATYPE(MemoUpdateParam)
+
+//------------------------------------------------------------------------------
+
+/// Writes memo changes in a worker thread using its own connection.
+/// Changes of the same memo that come before the previous one is written are coalesced.
+class MemoWriterWorker : public StoreWorker
+{
+    Q_OBJECT
+
+public:
+    explicit MemoWriterWorker(const QString& fileName);
+
+    void save(int memoId, const MemoUpdateParam& update);
+
+signals:
+    void saved(int memoId, const QDateTime& moment, const QString& error);
+
+protected:
+    void finishing() override;
+
+private:
+    QMap<int, MemoUpdateParam> _pending;
+
+    void writePending();
+    QString write(int memoId, const MemoUpdateParam& update);
+};
+
+//------------------------------------------------------------------------------
+
+/// Saves memos without blocking the GUI thread.
+/// All changes passed to the writer are written before it is destroyed.
+class MemoWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MemoWriter(const QString& fileName, QObject* parent = nullptr);
+    ~MemoWriter() override;
+
+    void save(int memoId, const MemoUpdateParam& update);
+
+signals:
+    /// Emitted when the change is written, the error is empty on success.
+    /// When several changes are coalesced, only the last one is reported.
+    void saved(int memoId, const QDateTime& moment, const QString& error);
+
+    /// Passes a request to the worker thread, it is not intended to be used outside.
+    void saveRequested(int memoId, const MemoUpdateParam& update);
+
+private:
+    QThread* _thread;
+};
+
+#endif // MEMO_WRITER_H
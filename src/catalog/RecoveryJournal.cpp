@@ -0,0 +1,305 @@
+#include "RecoveryJournal.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QMap>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTimer>
+
+static const quint32 JOURNAL_MAGIC = 0x50524A31; // "PRJ1"
+static const QDataStream::Version JOURNAL_STREAM_VERSION = QDataStream::Qt_5_6;
+
+// Changes are appended to the journal not more often than this
+static const int JOURNAL_FLUSH_INTERVAL_MS = 3000;
+
+enum JournalRecord : quint8
+{
+    RecordBegin = 1,
+    RecordChange,
+    RecordTitle,
+    RecordEnd,
+};
+
+static QString journalDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/recovery";
+}
+
+// Journals of different catalogs are distinguished by hash of the catalog path
+static QString journalPrefix(const QString& catalogFile)
+{
+    auto path = QFileInfo(catalogFile).absoluteFilePath();
+    return QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+//------------------------------------------------------------------------------
+//                              RecoveredMemo
+//------------------------------------------------------------------------------
+
+QString RecoveredMemo::restoreText(const QString& baseText, QString& text) const
+{
+    if (RecoveryJournal::textHash(baseText) != baseHash)
+        return QString("Memo has been changed after the unsaved editing began.");
+
+    text = baseText;
+    for (const MemoTextChange& change : changes)
+    {
+        if (change.position < 0 || change.position > text.size())
+            return QString("Recovery journal is damaged.");
+
+        // Text document reports changes including its trailing paragraph separator
+        // that is not a part of plain text, so the removed length can exceed the text.
+        text.replace(change.position, qMin(change.removed, text.size() - change.position), change.inserted);
+    }
+    return QString();
+}
+
+//------------------------------------------------------------------------------
+//                             RecoveryJournal
+//------------------------------------------------------------------------------
+
+RecoveryJournal::RecoveryJournal(const QString& catalogFile, QObject* parent) : QObject(parent)
+{
+    QString prefix = journalPrefix(catalogFile);
+    readRecovered(prefix);
+
+    auto stamp = QString::number(QDateTime::currentMSecsSinceEpoch());
+    _file.setFileName(QDir(journalDir()).filePath(prefix + '_' + stamp + ".journal"));
+}
+
+RecoveryJournal::~RecoveryJournal()
+{
+    // The catalog is closed properly, there is nothing to recover
+    if (_file.isOpen())
+    {
+        _file.close();
+        _file.remove();
+    }
+    delete _lock;
+}
+
+QByteArray RecoveryJournal::textHash(const QString& text)
+{
+    return QCryptographicHash::hash(QByteArray::fromRawData(
+        reinterpret_cast<const char*>(text.constData()), text.size() * int(sizeof(QChar))),
+        QCryptographicHash::Md5);
+}
+
+void RecoveryJournal::beginMemo(int memoId, const QString& title, const QString& text)
+{
+    writePendingChange();
+
+    QDataStream stream(&_buffer, QIODevice::Append);
+    stream.setVersion(JOURNAL_STREAM_VERSION);
+    stream << quint8(RecordBegin) << qint32(memoId) << title << textHash(text);
+    scheduleFlush();
+}
+
+void RecoveryJournal::changeMemo(int memoId, int position, int removed, const QString& inserted)
+{
+    // Typing produces a change per character, they are joined into one record
+    if (_pendingMemoId == memoId)
+    {
+        auto& pending = _pendingChange;
+        int pendingEnd = pending.position + pending.inserted.size();
+        if (removed == 0 && position == pendingEnd)
+        {
+            pending.inserted += inserted;
+            return;
+        }
+        if (inserted.isEmpty() && position >= pending.position && position + removed == pendingEnd)
+        {
+            pending.inserted.chop(removed);
+            return;
+        }
+    }
+
+    writePendingChange();
+
+    _pendingMemoId = memoId;
+    _pendingChange = { position, removed, inserted };
+    scheduleFlush();
+}
+
+void RecoveryJournal::changeTitle(int memoId, const QString& title)
+{
+    writePendingChange();
+
+    QDataStream stream(&_buffer, QIODevice::Append);
+    stream.setVersion(JOURNAL_STREAM_VERSION);
+    stream << quint8(RecordTitle) << qint32(memoId) << title;
+    scheduleFlush();
+}
+
+void RecoveryJournal::endMemo(int memoId)
+{
+    writePendingChange();
+
+    QDataStream stream(&_buffer, QIODevice::Append);
+    stream.setVersion(JOURNAL_STREAM_VERSION);
+    stream << quint8(RecordEnd) << qint32(memoId);
+    scheduleFlush();
+}
+
+void RecoveryJournal::writePendingChange()
+{
+    if (_pendingMemoId == 0) return;
+
+    QDataStream stream(&_buffer, QIODevice::Append);
+    stream.setVersion(JOURNAL_STREAM_VERSION);
+    stream << quint8(RecordChange) << qint32(_pendingMemoId)
+           << qint32(_pendingChange.position) << qint32(_pendingChange.removed) << _pendingChange.inserted;
+
+    _pendingMemoId = 0;
+    _pendingChange.inserted.clear();
+}
+
+void RecoveryJournal::scheduleFlush()
+{
+    if (!_flushTimer)
+    {
+        _flushTimer = new QTimer(this);
+        _flushTimer->setSingleShot(true);
+        _flushTimer->setInterval(JOURNAL_FLUSH_INTERVAL_MS);
+        connect(_flushTimer, &QTimer::timeout, this, [this]{
+            auto res = flush();
+            if (!res.isEmpty())
+                qWarning() << "Failed to write recovery journal" << res;
+        });
+    }
+    if (!_flushTimer->isActive())
+        _flushTimer->start();
+}
+
+QString RecoveryJournal::flush()
+{
+    writePendingChange();
+    if (_buffer.isEmpty()) return QString();
+
+    if (!_file.isOpen())
+    {
+        if (!QDir().mkpath(journalDir()))
+            return QString("Unable to create directory %1").arg(journalDir());
+
+        // The lock tells other instances of the program that the journal is in use
+        _lock = new QLockFile(_file.fileName() + ".lock");
+        _lock->setStaleLockTime(0);
+        _lock->tryLock(0);
+
+        if (!_file.open(QIODevice::WriteOnly | QIODevice::Append))
+            return QString("Unable to open file %1: %2").arg(_file.fileName(), _file.errorString());
+
+        QDataStream stream(&_file);
+        stream.setVersion(JOURNAL_STREAM_VERSION);
+        stream << JOURNAL_MAGIC;
+    }
+
+    if (_file.write(_buffer) != _buffer.size() || !_file.flush())
+        return QString("Unable to write file %1: %2").arg(_file.fileName(), _file.errorString());
+
+    _buffer.clear();
+    return QString();
+}
+
+void RecoveryJournal::readRecovered(const QString& filePrefix)
+{
+    QDir dir(journalDir());
+    auto fileNames = dir.entryList({ filePrefix + "_*.journal" }, QDir::Files, QDir::Name);
+    if (fileNames.isEmpty()) return;
+
+    // Journals are processed in order of their creation, so later sessions override earlier ones
+    QMap<int, RecoveredMemo> memos;
+    QSet<int> retitled;
+    for (auto& fileName : fileNames)
+    {
+        QString filePath = dir.filePath(fileName);
+
+        // The journal belongs to another instance of the program that has opened the same catalog
+        QLockFile lock(filePath + ".lock");
+        lock.setStaleLockTime(0);
+        if (!lock.tryLock(0)) continue;
+
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Unable to open recovery journal" << filePath << file.errorString();
+            continue;
+        }
+        _recoveredFiles << filePath;
+
+        QDataStream stream(&file);
+        stream.setVersion(JOURNAL_STREAM_VERSION);
+
+        quint32 magic = 0;
+        stream >> magic;
+        if (magic != JOURNAL_MAGIC)
+        {
+            qWarning() << "Unknown format of recovery journal" << filePath;
+            continue;
+        }
+
+        // The last record can be incomplete if the program crashed while writing it
+        while (!stream.atEnd())
+        {
+            quint8 record;
+            qint32 memoId;
+            stream >> record >> memoId;
+            if (record == RecordBegin)
+            {
+                RecoveredMemo memo;
+                memo.memoId = memoId;
+                stream >> memo.title >> memo.baseHash;
+                if (stream.status() != QDataStream::Ok) break;
+                memos[memoId] = memo;
+                retitled.remove(memoId);
+            }
+            else if (record == RecordChange)
+            {
+                qint32 position, removed;
+                QString inserted;
+                stream >> position >> removed >> inserted;
+                if (stream.status() != QDataStream::Ok) break;
+                auto it = memos.find(memoId);
+                if (it != memos.end())
+                    it->changes.append({ position, removed, inserted });
+            }
+            else if (record == RecordTitle)
+            {
+                QString title;
+                stream >> title;
+                if (stream.status() != QDataStream::Ok) break;
+                auto it = memos.find(memoId);
+                if (it != memos.end())
+                {
+                    it->title = title;
+                    retitled.insert(memoId);
+                }
+            }
+            else if (record == RecordEnd)
+            {
+                if (stream.status() != QDataStream::Ok) break;
+                memos.remove(memoId);
+            }
+            else break;
+        }
+    }
+
+    // Memos that were opened for editing but left unchanged don't need to be recovered
+    for (auto& memo : memos)
+        if (!memo.changes.isEmpty() || retitled.contains(memo.memoId))
+            _recovered << memo;
+}
+
+void RecoveryJournal::discardRecovered()
+{
+    for (auto& filePath : _recoveredFiles)
+        QFile::remove(filePath);
+    _recoveredFiles.clear();
+    _recovered.clear();
+}
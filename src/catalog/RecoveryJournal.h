@@ -0,0 +1,71 @@
+#ifndef RECOVERY_JOURNAL_H
+#define RECOVERY_JOURNAL_H
+
+#include <QFile>
+#include <QObject>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QLockFile;
+class QTimer;
+QT_END_NAMESPACE
+
+/// A change of memo text as it is reported by `QTextDocument::contentsChange`.
+struct MemoTextChange
+{
+    int position;
+    int removed;
+    QString inserted;
+};
+
+/// Unsaved edits of a memo found in journals left by a session that was not closed properly.
+struct RecoveredMemo
+{
+    int memoId;
+    QString title;
+    QByteArray baseHash;
+    QVector<MemoTextChange> changes;
+
+    /// Applies the changes to the memo text that was in the editor when the editing began.
+    QString restoreText(const QString& baseText, QString& text) const;
+};
+
+/// Keeps changes of memos being edited in a local file, so they can be recovered after a crash.
+/// Only incremental changes are stored, the memo text itself is represented by its hash.
+/// Changes are collected in memory and appended to the file every few seconds.
+/// Each session of the program writes its own journal, which is removed when the catalog is closed.
+class RecoveryJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RecoveryJournal(const QString& catalogFile, QObject* parent = nullptr);
+    ~RecoveryJournal() override;
+
+    void beginMemo(int memoId, const QString& title, const QString& text);
+    void changeMemo(int memoId, int position, int removed, const QString& inserted);
+    void changeTitle(int memoId, const QString& title);
+    void endMemo(int memoId);
+    QString flush();
+
+    const QList<RecoveredMemo>& recovered() const { return _recovered; }
+    void discardRecovered();
+
+    static QByteArray textHash(const QString& text);
+
+private:
+    QFile _file;
+    QByteArray _buffer;
+    MemoTextChange _pendingChange;
+    int _pendingMemoId = 0;
+    QLockFile* _lock = nullptr;
+    QTimer* _flushTimer = nullptr;
+    QStringList _recoveredFiles;
+    QList<RecoveredMemo> _recovered;
+
+    void readRecovered(const QString& filePrefix);
+    void writePendingChange();
+    void scheduleFlush();
+};
+
+#endif // RECOVERY_JOURNAL_H
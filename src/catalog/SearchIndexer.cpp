@@ -0,0 +1,94 @@
+#include "SearchIndexer.h"
+
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QThread>
+
+namespace {
+
+const int INDEX_BATCH_SIZE = 50;
+
+} // namespace
+
+//------------------------------------------------------------------------------
+//                              SearchIndexWorker
+//------------------------------------------------------------------------------
+
+SearchIndexWorker::SearchIndexWorker(const QString& fileName, QAtomicInt* cancelled)
+    : StoreWorker(fileName), _cancelled(cancelled)
+{
+}
+
+void SearchIndexWorker::started()
+{
+    QString res = openError();
+    if (res.isEmpty())
+    {
+        Ori::Sql::ConnectionGuard guard(connectionName());
+        res = updateIndex();
+    }
+    emit finished(res);
+}
+
+QString SearchIndexWorker::updateIndex()
+{
+    // Ids are selected by reading only small indexes, texts are read in write transactions by portions
+    QVector<int> staleIds;
+    QString res = CatalogStore::searchManager()->selectStaleIds(&staleIds);
+    if (!res.isEmpty()) return res;
+
+    res = processByPortions(staleIds, [](const QVector<int>& ids){
+        return CatalogStore::searchManager()->reindex(ids);
+    });
+    if (!res.isEmpty() || _cancelled->load()) return res;
+
+    QVector<int> orphanIds;
+    res = CatalogStore::searchManager()->selectOrphanIds(&orphanIds);
+    if (!res.isEmpty()) return res;
+
+    return processByPortions(orphanIds, [](const QVector<int>& ids){
+        return CatalogStore::searchManager()->removeFromIndex(ids);
+    });
+}
+
+QString SearchIndexWorker::processByPortions(const QVector<int>& ids, std::function<QString(const QVector<int>&)> process)
+{
+    for (int start = 0; start < ids.size() && !_cancelled->load(); start += INDEX_BATCH_SIZE)
+    {
+        // Memos are read in the write transaction, so the memo writer can't change them in between
+        QString res = CatalogStore::beginWriteTransaction();
+        if (!res.isEmpty()) return res;
+
+        res = process(ids.mid(start, INDEX_BATCH_SIZE));
+        if (!res.isEmpty())
+        {
+            CatalogStore::rollbackTransaction();
+            return res;
+        }
+
+        res = CatalogStore::commitTransaction();
+        if (!res.isEmpty()) return res;
+    }
+    return QString();
+}
+
+//------------------------------------------------------------------------------
+//                                SearchIndexer
+//------------------------------------------------------------------------------
+
+SearchIndexer::SearchIndexer(const QString& fileName, QObject* parent) : QObject(parent)
+{
+    auto worker = new SearchIndexWorker(fileName, &_cancelled);
+    _thread = StoreWorker::makeThread(worker, this);
+    connect(worker, &SearchIndexWorker::finished, this, &SearchIndexer::finished);
+
+    _thread->start();
+}
+
+/// Stops indexing after the current portion.
+SearchIndexer::~SearchIndexer()
+{
+    _cancelled.store(1);
+    StoreWorker::stopThread(_thread);
+}
@@ -0,0 +1,62 @@
+#ifndef SEARCH_INDEXER_H
+#define SEARCH_INDEXER_H
+
+#include "StoreWorker.h"
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QVector>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+//------------------------------------------------------------------------------
+
+/// Brings the full-text search index in line with memos in a worker thread using its own connection.
+/// Stale memos are indexed in small transactions, so memos saved meanwhile don't wait for the whole pass.
+class SearchIndexWorker : public StoreWorker
+{
+    Q_OBJECT
+
+public:
+    SearchIndexWorker(const QString& fileName, QAtomicInt* cancelled);
+
+signals:
+    void finished(const QString& error);
+
+protected:
+    void started() override;
+
+private:
+    QAtomicInt* _cancelled;
+
+    QString updateIndex();
+    QString processByPortions(const QVector<int>& ids, std::function<QString(const QVector<int>&)> process);
+};
+
+//------------------------------------------------------------------------------
+
+/// Indexes memos missing in the full-text search index or changed after indexing,
+/// and removes deleted ones from it without blocking the GUI thread.
+/// The pass starts right away and is cancelled when the indexer is deleted.
+class SearchIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SearchIndexer(const QString& fileName, QObject* parent = nullptr);
+    ~SearchIndexer() override;
+
+signals:
+    /// Emitted when the index is updated, the error is empty on success.
+    void finished(const QString& error);
+
+private:
+    QThread* _thread;
+    QAtomicInt _cancelled;
+};
+
+#endif // SEARCH_INDEXER_H
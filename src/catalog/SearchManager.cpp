@@ -0,0 +1,450 @@
+#include "SearchManager.h"
+
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QVersionNumber>
+
+using namespace Ori::Sql;
+
+//------------------------------------------------------------------------------
+//                              SearchTableDef
+//------------------------------------------------------------------------------
+
+namespace {
+
+class SearchTableDef : public TableDef
+{
+public:
+    SearchTableDef() : TableDef("MemoSearch") {}
+
+    const QString id = "Id";
+    const QString rowId = "RowId";
+    const QString title = "Title";
+    const QString data = "Data";
+    const QString query = "Query";
+    const QString limit = "Limit";
+
+    // Rowid of the index equals to Memo.Id.
+    // Contentless table keeps only the index, so memo texts are not stored twice,
+    // and especially not uncompressed. Rows can be deleted from it since SQLite 3.43,
+    // older versions get the table keeping its own copy of texts.
+    QString sqlCreate() const override {
+        return "CREATE VIRTUAL TABLE IF NOT EXISTS MemoSearch USING fts5(Title, Data)";
+    }
+    const QString sqlCreateContentless =
+        "CREATE VIRTUAL TABLE IF NOT EXISTS MemoSearch USING fts5(Title, Data, content='', contentless_delete=1)";
+    const QVersionNumber contentlessVersion = QVersionNumber(3, 43, 0);
+    const QString contentlessMarker = "contentless_delete";
+
+    const QString sqlSelectVersion = "SELECT sqlite_version()";
+    const QString sqlSelectDefinition = "SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'MemoSearch'";
+    const QString sqlDrop = "DROP TABLE MemoSearch";
+
+    // Only the table keeping texts has this shadow table
+    const QString sqlSelectContentSize =
+        "SELECT ifnull(sum(length(CAST(c0 AS BLOB)) + length(CAST(c1 AS BLOB))), 0) FROM MemoSearch_content";
+
+    const QString sqlInsert =
+        "INSERT INTO MemoSearch (rowid, Title, Data) VALUES (:RowId, :Title, :Data)";
+
+    const QString sqlDelete = "DELETE FROM MemoSearch WHERE rowid = :RowId";
+
+    const QString sqlSelectMemo = "SELECT Title, Data FROM Memo WHERE Id = :Id";
+
+    // Title matches are weighted much more than matches in memo text.
+    // Contentless table can't make snippets, they are made from memo texts.
+    const QString sqlSearch =
+        "SELECT rowid FROM MemoSearch WHERE MemoSearch MATCH :Query "
+        "ORDER BY bm25(MemoSearch, 10.0, 1.0) LIMIT :Limit";
+};
+
+SearchTableDef* searchTable() { static SearchTableDef t; return &t; }
+
+// Remembers the moment of the memo text which is in the index. Memos changed by a program version
+// that doesn't know about the index have other moments, so they are found without reading their texts.
+// There is no foreign key, rows of deleted memos are needed to find orphaned index rows.
+class SearchStateTableDef : public TableDef
+{
+public:
+    SearchStateTableDef() : TableDef("MemoSearchState") {}
+
+    const QString memoId = "MemoId";
+
+    QString sqlCreate() const override {
+        return "CREATE TABLE IF NOT EXISTS MemoSearchState (MemoId INTEGER PRIMARY KEY, Updated)";
+    }
+
+    const QString sqlCheckExists =
+        "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'MemoSearchState'";
+
+    // Covers Id and Updated, so looking for stale memos reads only this index
+    const QString sqlCreateUpdatedIndex = "CREATE INDEX IF NOT EXISTS Memo_Updated ON Memo (Updated)";
+
+    const QString sqlMarkIndexed =
+        "REPLACE INTO MemoSearchState (MemoId, Updated) SELECT Id, Updated FROM Memo WHERE Id = :MemoId";
+
+    const QString sqlDelete = "DELETE FROM MemoSearchState WHERE MemoId = :MemoId";
+    const QString sqlClear = "DELETE FROM MemoSearchState";
+
+    const QString sqlSelectStale =
+        "SELECT Memo.Id FROM Memo LEFT JOIN MemoSearchState ON MemoSearchState.MemoId = Memo.Id "
+        "WHERE MemoSearchState.MemoId IS NULL OR MemoSearchState.Updated IS NOT Memo.Updated";
+
+    const QString sqlSelectOrphans =
+        "SELECT MemoId FROM MemoSearchState "
+        "WHERE NOT EXISTS (SELECT 1 FROM Memo WHERE Memo.Id = MemoSearchState.MemoId)";
+};
+
+SearchStateTableDef* searchStateTable() { static SearchStateTableDef t; return &t; }
+
+QString selectIds(const QString& sql, QVector<int>* ids)
+{
+    SelectQuery query(sql);
+    if (query.isFailed()) return query.error();
+
+    while (query.next())
+        ids->append(query.record().value(0).toInt());
+    return QString();
+}
+
+// Converts user's text into FTS query. Each word is quoted to prevent
+// interpreting of query syntax and marked as prefix to find word forms.
+QString makeMatchQuery(const QString& text)
+{
+    QStringList terms;
+    for (auto word : text.split(' ', QString::SkipEmptyParts))
+        terms << '"' + word.replace('"', QStringLiteral("\"\"")) + "\"*";
+    return terms.join(' ');
+}
+
+// Words are split in the same way as the default FTS tokenizer does it
+bool isTokenChar(const QChar& ch)
+{
+    return ch.isLetterOrNumber();
+}
+
+// Makes a snippet of the text around the place having the most of matched words,
+// as FTS `snippet()` does. Query words are matched as prefixes, case insensitive.
+QString makeSnippet(const QString& text, const QString& query)
+{
+    const int SNIPPET_TOKENS = 16;
+
+    QStringList terms;
+    int pos = 0;
+    while (pos < query.size())
+    {
+        while (pos < query.size() && !isTokenChar(query.at(pos))) pos++;
+        int start = pos;
+        while (pos < query.size() && isTokenChar(query.at(pos))) pos++;
+        if (pos > start)
+            terms << query.mid(start, pos - start).toCaseFolded();
+    }
+
+    // [start, stop) of each word of the text and if it's matched
+    struct Token { int start; int stop; bool matched; };
+    QVector<Token> tokens;
+    pos = 0;
+    while (pos < text.size())
+    {
+        while (pos < text.size() && !isTokenChar(text.at(pos))) pos++;
+        int start = pos;
+        while (pos < text.size() && isTokenChar(text.at(pos))) pos++;
+        if (pos == start) break;
+
+        QString word = text.mid(start, pos - start).toCaseFolded();
+        bool matched = false;
+        for (const QString& term : terms)
+            if (word.startsWith(term))
+            {
+                matched = true;
+                break;
+            }
+        tokens.append({ start, pos, matched });
+    }
+    if (tokens.isEmpty()) return QString();
+
+    // Window of words having the most of matches, the first one wins
+    int windowSize = qMin(SNIPPET_TOKENS, tokens.size());
+    int count = 0;
+    for (int i = 0; i < windowSize; i++)
+        if (tokens.at(i).matched) count++;
+    int bestFirst = 0, bestCount = count;
+    for (int first = 1; first + windowSize <= tokens.size(); first++)
+    {
+        if (tokens.at(first - 1).matched) count--;
+        if (tokens.at(first + windowSize - 1).matched) count++;
+        if (count > bestCount)
+        {
+            bestCount = count;
+            bestFirst = first;
+        }
+    }
+
+    // The window is shifted to show a couple of words before the first match
+    if (bestCount > 0)
+    {
+        int firstMatch = bestFirst;
+        while (!tokens.at(firstMatch).matched) firstMatch++;
+        bestFirst = qMax(0, qMin(firstMatch - 2, tokens.size() - windowSize));
+    }
+
+    QString snippet;
+    if (bestFirst > 0)
+        snippet += QStringLiteral("...");
+    int last = bestFirst + windowSize - 1;
+    for (int i = bestFirst; i <= last; i++)
+    {
+        auto& token = tokens.at(i);
+        if (i > bestFirst)
+            snippet += text.midRef(tokens.at(i - 1).stop, token.start - tokens.at(i - 1).stop);
+        if (token.matched) snippet += SearchManager::matchBegin;
+        snippet += text.midRef(token.start, token.stop - token.start);
+        if (token.matched) snippet += SearchManager::matchEnd;
+    }
+    if (last < tokens.size() - 1)
+        snippet += QStringLiteral("...");
+    return snippet;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+//                              SearchManager
+//------------------------------------------------------------------------------
+
+const QChar SearchManager::matchBegin(0xE000);
+const QChar SearchManager::matchEnd(0xE001);
+
+QString SearchManager::prepare()
+{
+    // Search index is an optional feature, SQLite can be built without FTS5,
+    // so failing to create the index should not prevent catalog from opening.
+    // Don't use `createTable()` here, it rolls back the whole setup transaction.
+    _isAvailable = false;
+    auto res = prepareTable();
+    if (!res.isEmpty())
+    {
+        qWarning() << "Full-text search is unavailable" << res;
+        return QString();
+    }
+    _isAvailable = true;
+    return QString();
+}
+
+QString SearchManager::prepareTable()
+{
+    auto table = searchTable();
+
+    QVersionNumber version;
+    {
+        SelectQuery query(table->sqlSelectVersion);
+        if (query.isFailed()) return query.error();
+        if (query.next())
+            version = QVersionNumber::fromString(query.record().value(0).toString());
+    }
+    _isContentless = version >= table->contentlessVersion;
+
+    QString definition;
+    {
+        SelectQuery query(table->sqlSelectDefinition);
+        if (query.isFailed()) return query.error();
+        if (query.next())
+            definition = query.record().value(0).toString();
+    }
+    auto stateTable = searchStateTable();
+    bool hasState;
+    {
+        SelectQuery query(stateTable->sqlCheckExists);
+        if (query.isFailed()) return query.error();
+        hasState = query.next();
+    }
+
+    if (!definition.isEmpty())
+    {
+        bool isContentless = definition.contains(table->contentlessMarker);
+        if (isContentless && !_isContentless)
+            return QString("The index requires SQLite %1, the current version is %2.")
+                    .arg(table->contentlessVersion.toString(), version.toString());
+
+        // The table keeping texts is replaced, and rows not tracked by the state can't be checked.
+        // The index is filled again by the indexer.
+        if ((!isContentless && _isContentless) || !hasState)
+        {
+            auto res = ActionQuery(table->sqlDrop).exec();
+            if (!res.isEmpty()) return res;
+            definition.clear();
+        }
+    }
+    if (definition.isEmpty() && hasState)
+    {
+        auto res = ActionQuery(stateTable->sqlClear).exec();
+        if (!res.isEmpty()) return res;
+    }
+
+    auto res = ActionQuery(_isContentless ? table->sqlCreateContentless : table->sqlCreate()).exec();
+    if (!res.isEmpty()) return res;
+
+    res = ActionQuery(stateTable->sqlCreate()).exec();
+    if (!res.isEmpty()) return res;
+
+    return ActionQuery(stateTable->sqlCreateUpdatedIndex).exec();
+}
+
+/// Returns how much the search index takes for its own copy of memo texts, in bytes.
+/// Contentless index doesn't keep texts, it's only the index itself.
+QString SearchManager::selectContentSize(qint64* size) const
+{
+    *size = 0;
+    if (!_isAvailable || _isContentless) return QString();
+
+    SelectQuery query(searchTable()->sqlSelectContentSize);
+    if (query.isFailed())
+        return QString("Unable to calculate size of full-text search index.\n\n%1").arg(query.error());
+
+    if (query.next())
+        *size = query.record().value(0).toLongLong();
+    return QString();
+}
+
+/// Catalogs created before the search index was introduced, or modified by
+/// a program version that doesn't know about the index, can contain memos that are not indexed yet
+/// or were changed after indexing. Only the index of the Updated column is read to find them.
+QString SearchManager::selectStaleIds(QVector<int>* ids) const
+{
+    if (!_isAvailable) return QString();
+
+    auto res = selectIds(searchStateTable()->sqlSelectStale, ids);
+    if (!res.isEmpty())
+        return QString("Unable to select memos to update in full-text search index.\n\n%1").arg(res);
+    return QString();
+}
+
+/// Returns ids of deleted memos which are still in the index.
+QString SearchManager::selectOrphanIds(QVector<int>* ids) const
+{
+    if (!_isAvailable) return QString();
+
+    auto res = selectIds(searchStateTable()->sqlSelectOrphans, ids);
+    if (!res.isEmpty())
+        return QString("Unable to select deleted memos in full-text search index.\n\n%1").arg(res);
+    return QString();
+}
+
+/// Indexes current texts of the memos, memos deleted meanwhile are skipped.
+QString SearchManager::reindex(const QVector<int>& memoIds) const
+{
+    if (!_isAvailable) return QString();
+
+    auto table = searchTable();
+    for (int memoId : memoIds)
+    {
+        QString title, data;
+        {
+            SelectQuery query(table->sqlSelectMemo, {{ table->id, memoId }});
+            if (query.isFailed())
+                return QString("Unable to read memo #%1 for full-text search index.\n\n%2").arg(memoId).arg(query.error());
+            if (!query.next()) continue;
+
+            auto r = query.record();
+            title = r.value(table->title).toString();
+            data = MemoManager::decodeData(r.value(table->data));
+        }
+        QString res = updateIndex(memoId, title, data);
+        if (!res.isEmpty()) return res;
+    }
+    return QString();
+}
+
+QString SearchManager::updateIndex(int memoId, const QString& title, const QString& data) const
+{
+    if (!_isAvailable) return QString();
+
+    QString res = removeFromIndex(memoId);
+    if (!res.isEmpty()) return res;
+
+    auto table = searchTable();
+    res = ActionQuery(table->sqlInsert)
+            .param(table->rowId, memoId)
+            .param(table->title, title)
+            .param(table->data, data)
+            .exec();
+    if (!res.isEmpty()) return res;
+
+    // The moment is copied from the memo row, so it's exactly the same value as stored there
+    auto stateTable = searchStateTable();
+    return ActionQuery(stateTable->sqlMarkIndexed)
+            .param(stateTable->memoId, memoId)
+            .exec();
+}
+
+QString SearchManager::removeFromIndex(int memoId) const
+{
+    if (!_isAvailable) return QString();
+
+    auto table = searchTable();
+    QString res = ActionQuery(table->sqlDelete)
+            .param(table->rowId, memoId)
+            .exec();
+    if (!res.isEmpty()) return res;
+
+    auto stateTable = searchStateTable();
+    return ActionQuery(stateTable->sqlDelete)
+            .param(stateTable->memoId, memoId)
+            .exec();
+}
+
+QString SearchManager::removeFromIndex(const QVector<int>& memoIds) const
+{
+    for (int memoId : memoIds)
+    {
+        QString res = removeFromIndex(memoId);
+        if (!res.isEmpty()) return res;
+    }
+    return QString();
+}
+
+SearchResult SearchManager::search(const QString& text, int limit) const
+{
+    SearchResult result;
+
+    if (!_isAvailable)
+    {
+        result.error = QString("Full-text search is not supported by the database driver.");
+        return result;
+    }
+
+    QString matchQuery = makeMatchQuery(text);
+    if (matchQuery.isEmpty()) return result;
+
+    auto table = searchTable();
+
+    QList<int> ids;
+    {
+        SelectQuery query(table->sqlSearch, {
+            { table->query, matchQuery },
+            { table->limit, limit }
+        });
+        if (query.isFailed())
+        {
+            result.error = QString("Unable to search memos.\n\n%1").arg(query.error());
+            return result;
+        }
+
+        while (query.next())
+            ids << query.record().value(0).toInt();
+    }
+    if (ids.isEmpty()) return result;
+
+    auto memos = CatalogStore::memoManager()->selectData(ids);
+    if (!memos.error.isEmpty())
+    {
+        result.error = memos.error;
+        return result;
+    }
+
+    for (int id : ids)
+        result.hits.append({ id, makeSnippet(memos.data.value(id), text) });
+
+    return result;
+}
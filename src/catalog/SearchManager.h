@@ -0,0 +1,48 @@
+#ifndef SEARCH_MANAGER_H
+#define SEARCH_MANAGER_H
+
+#include <QString>
+#include <QVector>
+
+struct SearchHit
+{
+    int memoId;
+    QString snippet;
+};
+
+struct SearchResult
+{
+    QString error;
+    QVector<SearchHit> hits;
+};
+
+class SearchManager
+{
+public:
+    // Snippet returned in SearchHit contains matched words wrapped in these markers.
+    // They are private-use characters, so they never clash with memo text
+    // and a snippet can be safely html-escaped before replacing them with tags.
+    static const QChar matchBegin;
+    static const QChar matchEnd;
+
+    QString prepare();
+
+    bool isAvailable() const { return _isAvailable; }
+    QString selectContentSize(qint64* size) const;
+
+    QString updateIndex(int memoId, const QString& title, const QString& data) const;
+    QString removeFromIndex(int memoId) const;
+    QString removeFromIndex(const QVector<int>& memoIds) const;
+    QString selectStaleIds(QVector<int>* ids) const;
+    QString selectOrphanIds(QVector<int>* ids) const;
+    QString reindex(const QVector<int>& memoIds) const;
+    SearchResult search(const QString& text, int limit) const;
+
+private:
+    bool _isAvailable = false;
+    bool _isContentless = false;
+
+    QString prepareTable();
+};
+
+#endif // SEARCH_MANAGER_H
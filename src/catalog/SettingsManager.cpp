@@ -22,8 +22,16 @@ public:
         return "CREATE TABLE IF NOT EXISTS Settings (Id, Value)";
     }
 
-    const QString sqlInsert = "INSERT INTO Settings (Id, Value) VALUES (:Id, :Value)";
-    const QString sqlUpdate = "UPDATE Settings SET Value = :Value WHERE Id = :Id";
+    // Works as upsert thanks to the unique index on Id
+    const QString sqlReplace = "REPLACE INTO Settings (Id, Value) VALUES (:Id, :Value)";
+
+    const QString uniqueIndexName = "Settings_Id";
+    const QString sqlCheckUniqueIndex =
+        "SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = '" + uniqueIndexName + "'";
+    const QString sqlCreateUniqueIndex =
+        "CREATE UNIQUE INDEX IF NOT EXISTS " + uniqueIndexName + " ON Settings (Id)";
+    const QString sqlDeleteDuplicates =
+        "DELETE FROM Settings WHERE rowid NOT IN (SELECT MAX(rowid) FROM Settings GROUP BY Id)";
 };
 
 SettingsTableDef* settingsTable() { static SettingsTableDef t; return &t; }
@@ -36,21 +44,104 @@ SettingsTableDef* settingsTable() { static SettingsTableDef t; return &t; }
 
 QString SettingsManager::prepare()
 {
-    return createTable(settingsTable());
+    auto table = settingsTable();
+
+    QString res = createTable(table);
+    if (!res.isEmpty()) return res;
+
+    bool hasIndex;
+    {
+        SelectQuery query(table->sqlCheckUniqueIndex);
+        if (query.isFailed())
+            return QString("Unable to check indexes of settings table.\n\n%1").arg(query.error());
+        hasIndex = query.next();
+    }
+    if (hasIndex) return QString();
+
+    // Previous program versions could write the same setting several times
+    res = ActionQuery(table->sqlDeleteDuplicates).exec();
+    if (!res.isEmpty())
+        return QString("Unable to remove duplicated settings.\n\n%1").arg(res);
+
+    res = ActionQuery(table->sqlCreateUniqueIndex).exec();
+    if (!res.isEmpty())
+        return QString("Unable to create index for settings table.\n\n%1").arg(res);
+
+    return QString();
 }
 
-void SettingsManager::writeValue(const QString& id, const QVariant& value) const
+QString SettingsManager::load()
 {
     auto table = settingsTable();
 
-    SelectQuery query(table->sqlCheckId(id));
+    _values.clear();
+    _pending.clear();
+    _isLoaded = false;
+
+    SelectQuery query(table->sqlSelectAll());
     if (query.isFailed())
+        return QString("Unable to load settings.\n\n%1").arg(query.error());
+
+    while (query.next())
+    {
+        auto r = query.record();
+        _values.insert(r.value(table->id).toString(), r.value(table->value));
+    }
+    _isLoaded = true;
+    return QString();
+}
+
+/// Writes all changed settings in one transaction.
+QString SettingsManager::flush()
+{
+    if (_pending.isEmpty()) return QString();
+
+    auto table = settingsTable();
+    auto db = database();
+
+    if (!db.transaction())
+        return QString("Unable to begin transaction for writing settings.\n\n%1")
+                .arg(SqlHelper::errorText(db.lastError()));
+
+    for (auto it = _pending.constBegin(); it != _pending.constEnd(); it++)
+    {
+        QString res = ActionQuery(table->sqlReplace)
+                .param(table->id, it.key())
+                .param(table->value, it.value())
+                .exec();
+        if (!res.isEmpty())
+        {
+            db.rollback();
+            return QString("Unable to write setting '%1'.\n\n%2").arg(it.key(), res);
+        }
+    }
+
+    if (!db.commit())
+        return QString("Unable to commit settings.\n\n%1").arg(SqlHelper::errorText(db.lastError()));
+
+    _pending.clear();
+    return QString();
+}
+
+void SettingsManager::unload()
+{
+    _values.clear();
+    _pending.clear();
+    _isLoaded = false;
+}
+
+void SettingsManager::writeValue(const QString& id, const QVariant& value)
+{
+    if (_isLoaded)
     {
-        qWarning() << "Unable to write setting" << id << query.error();
+        _values[id] = value;
+        _pending[id] = value;
         return;
     }
-    QString sql = query.next() ? table->sqlUpdate : table->sqlInsert;
-    QString res = ActionQuery(sql)
+
+    // Settings not loaded into memory are written immediately
+    auto table = settingsTable();
+    QString res = ActionQuery(table->sqlReplace)
             .param(table->id, id)
             .param(table->value, value)
             .exec();
@@ -60,9 +151,17 @@ void SettingsManager::writeValue(const QString& id, const QVariant& value) const
 
 QVariant SettingsManager::readValue(const QString& id, const QVariant& defValue, bool *hasValue) const
 {
+    if (_isLoaded)
+    {
+        auto it = _values.constFind(id);
+        if (hasValue)
+            *hasValue = it != _values.constEnd();
+        return it != _values.constEnd() ? it.value() : defValue;
+    }
+
     auto table = settingsTable();
 
-    SelectQuery query(table->sqlSelectById(id));
+    SelectQuery query(table->sqlSelectByIdParam(), {{ table->id, id }});
     if (query.isFailed())
     {
         qWarning() << "Unable to read setting" << id << query.error();
@@ -79,7 +178,7 @@ QVariant SettingsManager::readValue(const QString& id, const QVariant& defValue,
     return query.record().field(table->value).value();
 }
 
-void SettingsManager::writeString(const QString& id, const QString& value) const
+void SettingsManager::writeString(const QString& id, const QString& value)
 {
     bool hasValue;
     QString oldValue = readValue(id, QVariant(), &hasValue).toString();
@@ -92,7 +191,7 @@ QString SettingsManager::readString(const QString& id, const QString& defValue)
     return readValue(id, defValue).toString();
 }
 
-void SettingsManager::writeBool(const QString& id, bool value) const
+void SettingsManager::writeBool(const QString& id, bool value)
 {
     bool hasValue;
     bool oldValue = readValue(id, QVariant(), &hasValue).toBool();
@@ -105,7 +204,7 @@ bool SettingsManager::readBool(const QString& id, bool defValue) const
     return readValue(id, defValue).toBool();
 }
 
-void SettingsManager::writeInt(const QString& id, int value) const
+void SettingsManager::writeInt(const QString& id, int value)
 {
     bool hasValue;
     int oldValue = readValue(id, QVariant(), &hasValue).toInt();
@@ -118,7 +217,7 @@ int SettingsManager::readInt(const QString& id, int defValue) const
     return readValue(id, defValue).toInt();
 }
 
-void SettingsManager::writeIntArray(const QString& id, const QVector<int>& values, TrackChangesFlag trackChangesFlag) const
+void SettingsManager::writeIntArray(const QString& id, const QVector<int>& values, TrackChangesFlag trackChangesFlag)
 {
     if (trackChangesFlag == IgnoreValuesOrder)
     {
@@ -1,10 +1,15 @@
 #ifndef SETTINGS_MANAGER_H
 #define SETTINGS_MANAGER_H
 
+#include <QHash>
 #include <QString>
 #include <QVector>
 #include <QVariant>
 
+/// Settings stored in the catalog database.
+/// After `load()`, all settings are kept in memory, so reading them doesn't query the database,
+/// and changed values are only written by `flush()`. The catalog calls it shortly after changes and when closed.
+/// The cache belongs to the main connection and must be used from the GUI thread only.
 class SettingsManager
 {
 public:
@@ -12,21 +17,30 @@ public:
 
     QString prepare();
 
-    void writeValue(const QString& id, const QVariant& value) const;
+    QString load();
+    QString flush();
+    void unload();
+
+    void writeValue(const QString& id, const QVariant& value);
     QVariant readValue(const QString& id, const QVariant& defValue = QVariant(), bool *hasValue = nullptr) const;
 
-    void writeString(const QString& id, const QString& value) const;
+    void writeString(const QString& id, const QString& value);
     QString readString(const QString& id, const QString& defValue = QString()) const;
 
-    void writeBool(const QString& id, bool value) const;
+    void writeBool(const QString& id, bool value);
     bool readBool(const QString& id, bool defValue) const;
 
-    void writeInt(const QString& id, int value) const;
+    void writeInt(const QString& id, int value);
     int readInt(const QString& id, int defValue) const;
 
     void writeIntArray(const QString& id, const QVector<int>& values,
-                       TrackChangesFlag trackChangesFlag = IgnoreValuesOrder) const;
+                       TrackChangesFlag trackChangesFlag = IgnoreValuesOrder);
     QVector<int> readIntArray(const QString& id) const;
+
+private:
+    bool _isLoaded = false;
+    QHash<QString, QVariant> _values;
+    QHash<QString, QVariant> _pending;
 };
 
 #endif // SETTINGS_MANAGER_H
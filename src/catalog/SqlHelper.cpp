@@ -1,5 +1,7 @@
 #include "SqlHelper.h"
 
+#include <QMutex>
+
 namespace SqlHelper {
 
 void addField(QSqlRecord &record, const QString &name, QVariant::Type type, const QVariant &value)
@@ -49,6 +51,85 @@ QString errorText(const QSqlError &error)
 namespace Ori {
 namespace Sql {
 
+static thread_local QString currentConnectionName;
+
+namespace {
+
+// Cache is cleaned when it becomes too big, e.g. when there are many arbitrary queries from SQL console
+const int STATEMENT_CACHE_LIMIT = 100;
+
+struct StatementCache
+{
+    QMutex mutex;
+
+    // connectionName -> sql -> query
+    QHash<QString, QHash<QString, QSqlQuery>> queries;
+};
+
+StatementCache& statementCache() { static StatementCache cache; return cache; }
+
+} // namespace
+
+QSqlDatabase database()
+{
+    if (currentConnectionName.isEmpty())
+        return QSqlDatabase::database();
+    return QSqlDatabase::database(currentConnectionName, false);
+}
+
+ConnectionGuard::ConnectionGuard(const QString& connectionName)
+{
+    _prevConnectionName = currentConnectionName;
+    currentConnectionName = connectionName;
+}
+
+ConnectionGuard::~ConnectionGuard()
+{
+    currentConnectionName = _prevConnectionName;
+}
+
+QSqlQuery cachedQuery(const QString& sql, QString* error)
+{
+    auto db = database();
+    auto& cache = statementCache();
+
+    // Each connection is used only in its own thread, the lock protects the map itself
+    QMutexLocker locker(&cache.mutex);
+    auto& queries = cache.queries[db.connectionName()];
+
+    auto it = queries.constFind(sql);
+    if (it != queries.constEnd())
+    {
+        // The same statement can be still in use, e.g. when iterating recursively
+        if (!it.value().isActive())
+            return it.value();
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql))
+    {
+        *error = SqlHelper::errorText(query, true);
+        return query;
+    }
+
+    if (it == queries.constEnd())
+    {
+        if (queries.size() >= STATEMENT_CACHE_LIMIT)
+            for (auto q = queries.begin(); q != queries.end(); )
+                if (q.value().isActive()) q++; else q = queries.erase(q);
+        queries.insert(sql, query);
+    }
+    return query;
+}
+
+void clearStatementCache(const QString& connectionName)
+{
+    auto& cache = statementCache();
+    QMutexLocker locker(&cache.mutex);
+    cache.queries.remove(connectionName);
+}
+
 TableDef::~TableDef()
 {}
 
@@ -57,7 +138,7 @@ QString createTable(TableDef *table)
     auto res = ActionQuery(table->sqlCreate()).exec();
     if (!res.isEmpty())
     {
-        QSqlDatabase::database().rollback();
+        database().rollback();
         return QString("Unable to create table '%1'.\n\n%2").arg(table->tableName()).arg(res);
     }
     return QString();
@@ -69,7 +150,7 @@ QString addColumnIfNotExist(const QString& tableName, const QString& columnName)
                               "AND name = '%1' AND sql LIKE '%%%2%%'").arg(tableName, columnName));
     if (query.isFailed())
     {
-        QSqlDatabase::database().rollback();
+        database().rollback();
         return QString("Failed to check if column '%1' exists in table '%2'.\n\n%3")
                 .arg(tableName, columnName, query.error());
     }
@@ -81,12 +162,23 @@ QString addColumnIfNotExist(const QString& tableName, const QString& columnName)
     auto res = ActionQuery(QString("ALTER TABLE %1 ADD COLUMN %2").arg(tableName, columnName)).exec();
     if (!res.isEmpty())
     {
-        QSqlDatabase::database().rollback();
+        database().rollback();
         return QString("Unable to add column '%1' into table '%2'.\n\n%3").arg(columnName, tableName, res);
     }
 
     return QString();
 }
 
+QString createIndexIfNotExist(const QString& tableName, const QString& columnName)
+{
+    auto res = ActionQuery(QString("CREATE INDEX IF NOT EXISTS %1_%2 ON %1 (%2)").arg(tableName, columnName)).exec();
+    if (!res.isEmpty())
+    {
+        database().rollback();
+        return QString("Unable to create index on column '%1' of table '%2'.\n\n%3").arg(columnName, tableName, res);
+    }
+    return QString();
+}
+
 } // namespace Sql
 } // namespace Ori
@@ -21,12 +21,44 @@ QString errorText(const QSqlError &error);
 namespace Ori {
 namespace Sql {
 
+/// Returns a connection that should be used by queries in the current thread.
+/// This is the default connection unless another one is set by `ConnectionGuard`.
+QSqlDatabase database();
+
+/// Makes all queries created in the current thread to use the given connection.
+/// Connections can't be shared between threads, so a worker thread opens its own one
+/// and uses this guard to run the same table managers as the main thread does.
+class ConnectionGuard
+{
+public:
+    ConnectionGuard(const QString& connectionName);
+    ~ConnectionGuard();
+
+private:
+    QString _prevConnectionName;
+};
+
+/// Returns a query prepared for the given sql on the connection of the current thread.
+/// Prepared queries are cached per connection by their sql text, so SQLite doesn't
+/// have to parse and plan the same statement again. A query must be finished after use,
+/// otherwise the next request for the same sql gets a new, not cached, query.
+/// Statements should use bound parameters instead of values formatted into sql text.
+QSqlQuery cachedQuery(const QString& sql, QString* error);
+
+/// Must be called before the connection is closed.
+void clearStatementCache(const QString& connectionName);
+
+
 class ActionQuery
 {
 public:
-    ActionQuery(const QString& sql)
+    ActionQuery(const QString& sql) : _query(cachedQuery(sql, &_error))
     {
-        _query.prepare(sql);
+    }
+
+    ~ActionQuery()
+    {
+        _query.finish();
     }
 
     ActionQuery& param(const QString& name, const QVariant& value)
@@ -37,12 +69,17 @@ public:
 
     QString exec()
     {
+        if (!_error.isEmpty())
+            return _error;
         if (!_query.exec())
             return SqlHelper::errorText(_query, true);
         return QString();
     }
 
+    QVariant lastInsertId() const { return _query.lastInsertId(); }
+
 private:
+    QString _error;
     QSqlQuery _query;
 };
 
@@ -50,12 +87,26 @@ private:
 class SelectQuery
 {
 public:
-    SelectQuery(const QString& sql)
+    SelectQuery(const QString& sql) : SelectQuery(sql, QMap<QString, QVariant>())
+    {
+    }
+
+    SelectQuery(const QString& sql, const QMap<QString, QVariant>& params) : _query(cachedQuery(sql, &_error))
     {
-        if (!_query.exec(sql))
+        if (!_error.isEmpty()) return;
+
+        for (auto it = params.constBegin(); it != params.constEnd(); it++)
+            _query.bindValue(':' + it.key(), it.value());
+
+        if (!_query.exec())
             _error = SqlHelper::errorText(_query, true);
     }
 
+    ~SelectQuery()
+    {
+        _query.finish();
+    }
+
     bool isFailed() const { return !_error.isEmpty(); }
     const QString& error() const { return _error; }
     const QSqlRecord& record() const { return _record; }
@@ -68,12 +119,12 @@ public:
         return ok;
     }
 
+private:
+    QString _error;
+
 protected:
     QSqlQuery _query;
     QSqlRecord _record;
-
-private:
-    QString _error;
 };
 
 
@@ -94,6 +145,11 @@ public:
         return QString("SELECT COUNT(Id) FROM %1").arg(_tableName);
     }
 
+    // Id is passed as parameter :Id
+    virtual QString sqlSelectByIdParam() const {
+        return QString("SELECT * FROM %1 WHERE Id = :Id").arg(_tableName);
+    }
+
     virtual QString sqlSelectById(int id) const {
         return QString("SELECT * FROM %1 WHERE Id = %2").arg(_tableName).arg(id);
     }
@@ -106,6 +162,11 @@ public:
         return QString("SELECT MAX(Id) FROM %1").arg(_tableName);
     }
 
+    // Id is passed as parameter :Id
+    virtual QString sqlCheckIdParam() const {
+        return QString("SELECT Id FROM %1 WHERE Id = :Id LIMIT 1").arg(_tableName);
+    }
+
     virtual QString sqlCheckId(int id) const {
         return QString("SELECT Id FROM %1 WHERE Id = %2 LIMIT 1").arg(_tableName).arg(id);
     }
@@ -124,6 +185,7 @@ private:
 
 QString createTable(TableDef *table);
 QString addColumnIfNotExist(const QString& tableName, const QString& columnName);
+QString createIndexIfNotExist(const QString& tableName, const QString& columnName);
 
 } // namespace Sql
 } // namespace Ori
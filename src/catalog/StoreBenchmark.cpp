@@ -0,0 +1,106 @@
+#include "StoreBenchmark.h"
+
+#include "CatalogStore.h"
+#include "SqlHelper.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+using namespace Ori::Sql;
+
+namespace StoreBenchmark {
+
+namespace {
+
+const QString CONNECTION_NAME("StoreBenchmark");
+
+QString memoText()
+{
+    return QString("Lorem ipsum dolor sit amet, consectetur adipiscing elit. ").repeated(64);
+}
+
+struct ProfileResult
+{
+    QString error;
+    double avgMs = 0;
+    double maxMs = 0;
+};
+
+// Each save is a separate transaction, as when a memo is saved from the editor
+ProfileResult measureSaves(int saveCount)
+{
+    ProfileResult result;
+
+    result.error = CatalogStore::prepareDatabase();
+    if (!result.error.isEmpty()) return result;
+
+    ActionQuery insert("INSERT INTO Memo (Title, Data) VALUES ('Benchmark', '')");
+    result.error = insert.exec();
+    if (!result.error.isEmpty()) return result;
+    int memoId = insert.lastInsertId().toInt();
+
+    QString data = memoText();
+
+    qint64 totalNs = 0, maxNs = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < saveCount; i++)
+    {
+        timer.start();
+        result.error = ActionQuery("UPDATE Memo SET Data = :Data, Updated = :Updated WHERE Id = :Id")
+                .param("Data", MemoManager::encodeData(data + QString::number(i)))
+                .param("Updated", QDateTime::currentDateTime())
+                .param("Id", memoId)
+                .exec();
+        if (!result.error.isEmpty()) return result;
+        qint64 ns = timer.nsecsElapsed();
+        totalNs += ns;
+        maxNs = qMax(maxNs, ns);
+    }
+    result.avgMs = totalNs / 1e6 / saveCount;
+    result.maxMs = maxNs / 1e6;
+    return result;
+}
+
+ProfileResult measureProfile(const CatalogStore::StoreConfig& config, int saveCount)
+{
+    ProfileResult result;
+
+    QTemporaryDir dir;
+    if (!dir.isValid())
+    {
+        result.error = QString("Unable to create temporary directory.");
+        return result;
+    }
+
+    result.error = CatalogStore::addConnection(CONNECTION_NAME, dir.filePath("benchmark.enot"), config);
+    if (result.error.isEmpty())
+    {
+        ConnectionGuard guard(CONNECTION_NAME);
+        result = measureSaves(saveCount);
+    }
+    CatalogStore::removeConnection(CONNECTION_NAME);
+    return result;
+}
+
+} // namespace
+
+QString run(int saveCount)
+{
+    QStringList report;
+    report << QString("Memo save latency, %1 saves of %2 characters text:").arg(saveCount).arg(memoText().size());
+
+    for (auto config : { CatalogStore::StoreConfig::fast(), CatalogStore::StoreConfig::safe() })
+    {
+        auto result = measureProfile(config, saveCount);
+        if (!result.error.isEmpty())
+            report << QString("%1: failed\n%2").arg(config.name, result.error);
+        else
+            report << QString("%1 (journal %2, synchronous %3): average %4 ms, max %5 ms")
+                      .arg(config.name, config.journalMode, config.synchronous)
+                      .arg(result.avgMs, 0, 'f', 3).arg(result.maxMs, 0, 'f', 3);
+    }
+    return report.join("\n\n");
+}
+
+} // namespace StoreBenchmark
@@ -0,0 +1,15 @@
+#ifndef STORE_BENCHMARK_H
+#define STORE_BENCHMARK_H
+
+#include <QString>
+
+namespace StoreBenchmark {
+
+/// Measures memo save latency under each store profile using a temporary notebook.
+/// Returns a human readable report. The temporary file is created in the system temp
+/// directory, so the results are only meaningful for the drive where it is located.
+QString run(int saveCount = 200);
+
+} // namespace StoreBenchmark
+
+#endif // STORE_BENCHMARK_H
@@ -0,0 +1,44 @@
+#include "StoreWorker.h"
+
+#include "CatalogStore.h"
+
+#include <QThread>
+
+StoreWorker::StoreWorker(const QString& fileName) : QObject(), _fileName(fileName)
+{
+}
+
+QThread* StoreWorker::makeThread(StoreWorker* worker, QObject* owner)
+{
+    worker->_connectionName = QString("%1_%2").arg(owner->metaObject()->className()).arg(quintptr(owner));
+
+    auto thread = new QThread(owner);
+    worker->moveToThread(thread);
+
+    connect(thread, &QThread::started, worker, &StoreWorker::open);
+    // Direct connection makes the connection be closed in the thread where it was opened
+    connect(thread, &QThread::finished, worker, &StoreWorker::close, Qt::DirectConnection);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    return thread;
+}
+
+void StoreWorker::stopThread(QThread* thread)
+{
+    if (thread && thread->isRunning())
+    {
+        thread->quit();
+        thread->wait();
+    }
+}
+
+void StoreWorker::open()
+{
+    _openError = CatalogStore::addConnection(_connectionName, _fileName);
+    started();
+}
+
+void StoreWorker::close()
+{
+    finishing();
+    CatalogStore::removeConnection(_connectionName);
+}
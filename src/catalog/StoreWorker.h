@@ -0,0 +1,50 @@
+#ifndef STORE_WORKER_H
+#define STORE_WORKER_H
+
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+/// Base for objects that work with the catalog database in a worker thread.
+/// Connections can't be shared between threads, so the worker opens its own one
+/// when the thread starts and closes it when the thread finishes.
+class StoreWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// Moves the worker to a new thread owned by the `owner`, the thread is not started.
+    /// The worker is deleted when the thread finishes. The connection is named after the owner,
+    /// so the owner must not have more than one worker at the same time.
+    static QThread* makeThread(StoreWorker* worker, QObject* owner);
+
+    /// Stops the thread and waits until the worker finishes its work.
+    static void stopThread(QThread* thread);
+
+protected:
+    explicit StoreWorker(const QString& fileName);
+
+    const QString& connectionName() const { return _connectionName; }
+
+    /// Not empty when the connection could not be opened, then the worker should report it.
+    const QString& openError() const { return _openError; }
+
+    /// Called in the worker thread after the connection is opened, even if unsuccessfully.
+    virtual void started() {}
+
+    /// Called in the worker thread before the connection is closed.
+    /// The event loop is already stopped here.
+    virtual void finishing() {}
+
+private:
+    QString _fileName;
+    QString _connectionName;
+    QString _openError;
+
+    void open();
+    void close();
+};
+
+#endif // STORE_WORKER_H
@@ -0,0 +1,224 @@
+#include "TextDelta.h"
+
+#include <QDataStream>
+#include <QHash>
+#include <QVector>
+
+namespace TextDelta {
+
+namespace {
+
+const quint8 FORMAT_VERSION = 1;
+const QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_6;
+
+// Deltas of big insertions are compressed, small ones are stored as is
+const int COMPRESSION_THRESHOLD = 1024;
+
+// Referencing short matches, e.g. empty lines, takes more space than inserting them
+const int MIN_COPY_LENGTH = 8;
+
+enum Operation : quint8
+{
+    OpCopy = 1,
+    OpInsert,
+};
+
+struct Line
+{
+    int start;
+    int length;
+};
+
+// Lines include their line breaks, so concatenation of lines gives the text back
+QVector<Line> splitLines(const QString& text)
+{
+    QVector<Line> lines;
+    int start = 0;
+    while (start < text.size())
+    {
+        int end = text.indexOf('\n', start);
+        end = end < 0 ? text.size() : end + 1;
+        lines.append({ start, end - start });
+        start = end;
+    }
+    return lines;
+}
+
+class DeltaWriter
+{
+public:
+    explicit DeltaWriter(const QString& target) : _target(target), _stream(&_ops, QIODevice::WriteOnly)
+    {
+        _stream.setVersion(STREAM_VERSION);
+    }
+
+    void copy(int offset, int length, int targetStart)
+    {
+        if (length < MIN_COPY_LENGTH)
+        {
+            insert(targetStart, length);
+            return;
+        }
+        writeInsert();
+        if (_copyLength > 0 && _copyOffset + _copyLength == offset)
+        {
+            _copyLength += length;
+            return;
+        }
+        writeCopy();
+        _copyOffset = offset;
+        _copyLength = length;
+    }
+
+    void insert(int targetStart, int length)
+    {
+        writeCopy();
+        if (_insertLength == 0)
+            _insertStart = targetStart;
+        _insertLength += length;
+    }
+
+    QByteArray finish()
+    {
+        writeCopy();
+        writeInsert();
+        return _ops;
+    }
+
+private:
+    const QString& _target;
+    QByteArray _ops;
+    QDataStream _stream;
+    int _copyOffset = 0, _copyLength = 0;
+    int _insertStart = 0, _insertLength = 0;
+
+    void writeCopy()
+    {
+        if (_copyLength == 0) return;
+        _stream << quint8(OpCopy) << quint32(_copyOffset) << quint32(_copyLength);
+        _copyLength = 0;
+    }
+
+    void writeInsert()
+    {
+        if (_insertLength == 0) return;
+        _stream << quint8(OpInsert) << _target.mid(_insertStart, _insertLength);
+        _insertLength = 0;
+    }
+};
+
+} // namespace
+
+QByteArray make(const QString& source, const QString& target)
+{
+    auto sourceLines = splitLines(source);
+    auto targetLines = splitLines(target);
+
+    // Only the first occurrence of a repeated line is remembered,
+    // matches of its next occurrences are found by extending previous runs.
+    QHash<QStringRef, int> sourceIndex;
+    sourceIndex.reserve(sourceLines.size());
+    for (int i = 0; i < sourceLines.size(); i++)
+    {
+        QStringRef line(&source, sourceLines.at(i).start, sourceLines.at(i).length);
+        if (!sourceIndex.contains(line))
+            sourceIndex.insert(line, i);
+    }
+
+    auto sourceLine = [&](int i) { return QStringRef(&source, sourceLines.at(i).start, sourceLines.at(i).length); };
+    auto targetLine = [&](int i) { return QStringRef(&target, targetLines.at(i).start, targetLines.at(i).length); };
+
+    DeltaWriter writer(target);
+    int nextSource = 0;
+    int t = 0;
+    while (t < targetLines.size())
+    {
+        // The line following the previous match is tried first, it keeps repeated lines in place
+        int s = -1;
+        if (nextSource < sourceLines.size() && sourceLine(nextSource) == targetLine(t))
+            s = nextSource;
+        else
+            s = sourceIndex.value(targetLine(t), -1);
+
+        if (s < 0)
+        {
+            writer.insert(targetLines.at(t).start, targetLines.at(t).length);
+            t++;
+            continue;
+        }
+
+        int count = 1;
+        while (t + count < targetLines.size() && s + count < sourceLines.size() &&
+               sourceLine(s + count) == targetLine(t + count))
+            count++;
+
+        int offset = sourceLines.at(s).start;
+        auto& lastLine = sourceLines.at(s + count - 1);
+        writer.copy(offset, lastLine.start + lastLine.length - offset, targetLines.at(t).start);
+
+        t += count;
+        nextSource = s + count;
+    }
+    QByteArray ops = writer.finish();
+
+    bool compressed = ops.size() >= COMPRESSION_THRESHOLD;
+    if (compressed)
+        ops = qCompress(ops);
+
+    QByteArray delta;
+    QDataStream stream(&delta, QIODevice::WriteOnly);
+    stream.setVersion(STREAM_VERSION);
+    stream << FORMAT_VERSION << quint8(compressed ? 1 : 0)
+           << quint32(source.size()) << quint32(target.size());
+    delta.append(ops);
+    return delta;
+}
+
+bool apply(const QString& source, const QByteArray& delta, QString& target)
+{
+    QDataStream header(delta);
+    header.setVersion(STREAM_VERSION);
+
+    quint8 version, compressed;
+    quint32 sourceSize, targetSize;
+    header >> version >> compressed >> sourceSize >> targetSize;
+    if (header.status() != QDataStream::Ok || version != FORMAT_VERSION) return false;
+    if (int(sourceSize) != source.size()) return false;
+
+    QByteArray ops = delta.mid(int(header.device()->pos()));
+    if (compressed)
+    {
+        ops = qUncompress(ops);
+        if (ops.isEmpty()) return false;
+    }
+
+    QDataStream stream(ops);
+    stream.setVersion(STREAM_VERSION);
+
+    target.clear();
+    target.reserve(int(targetSize));
+    while (!stream.atEnd())
+    {
+        quint8 op;
+        stream >> op;
+        if (op == OpCopy)
+        {
+            quint32 offset, length;
+            stream >> offset >> length;
+            if (stream.status() != QDataStream::Ok) return false;
+            if (qint64(offset) + length > source.size()) return false;
+            target.append(source.midRef(int(offset), int(length)));
+        }
+        else if (op == OpInsert)
+        {
+            QString text;
+            stream >> text;
+            if (stream.status() != QDataStream::Ok) return false;
+            target.append(text);
+        }
+        else return false;
+    }
+    return target.size() == int(targetSize);
+}
+
+} // namespace TextDelta
@@ -0,0 +1,19 @@
+#ifndef TEXT_DELTA_H
+#define TEXT_DELTA_H
+
+#include <QByteArray>
+#include <QString>
+
+/// Compact binary difference between two texts.
+/// Texts are compared line by line, lines of the target found in the source are stored
+/// as references to the source, so the delta size is proportional to changed lines.
+namespace TextDelta {
+
+QByteArray make(const QString& source, const QString& target);
+
+/// Restores the target text, fails when the delta is damaged or made for another source.
+bool apply(const QString& source, const QByteArray& delta, QString& target);
+
+} // namespace TextDelta
+
+#endif // TEXT_DELTA_H
@@ -6,6 +6,7 @@
 #include "../widgets/MemoTextEdit.h"
 
 #include <QPrinter>
+#include <QTextCursor>
 
 //------------------------------------------------------------------------------
 //                                 MemoEditor
@@ -67,15 +68,50 @@ QString TextMemoEditor::data() const
     return _editor->toPlainText();
 }
 
+void TextMemoEditor::setData(const QString& data)
+{
+    _editor->setPlainText(data);
+    _editor->document()->setModified(true);
+}
+
+void TextMemoEditor::documentChanged(int position, int charsRemoved, int charsAdded)
+{
+    auto doc = _editor->document();
+
+    // Syntax highlighter reports reformatted blocks as changed,
+    // but the text is the same and the document revision doesn't change.
+    if (charsRemoved == charsAdded && doc->revision() == _revision) return;
+    _revision = doc->revision();
+
+    // Only the inserted fragment is taken, getting the whole text is too slow for large memos
+    QString inserted;
+    if (charsAdded > 0)
+    {
+        QTextCursor cursor(doc);
+        cursor.setPosition(position);
+        cursor.setPosition(qMin(position + charsAdded, doc->characterCount() - 1), QTextCursor::KeepAnchor);
+        inserted = cursor.selectedText();
+        inserted.replace(QChar::ParagraphSeparator, '\n');
+        inserted.replace(QChar::LineSeparator, '\n');
+        inserted.replace(QChar::Nbsp, ' ');
+    }
+    emit onChanged(position, charsRemoved, inserted);
+}
+
 void TextMemoEditor::toggleSpellcheck(bool on)
 {
     if (on)
     {
-        if (!_spellcheckLang.isEmpty())
+        QList<Spellchecker*> spellcheckers;
+        for (auto lang : Spellchecker::splitLangs(_spellcheckLang))
         {
-            auto spellchecker = Spellchecker::get(_spellcheckLang);
-            if (!spellchecker) return; // Unable to open dictionary
-            _spellcheck = new TextEditSpellcheck(_editor, spellchecker, this);
+            auto spellchecker = Spellchecker::get(lang);
+            if (spellchecker) // Unable to open dictionary otherwise
+                spellcheckers << spellchecker;
+        }
+        if (!spellcheckers.isEmpty())
+        {
+            _spellcheck = new TextEditSpellcheck(_editor, spellcheckers, this);
             _spellcheck->spellcheckAll();
         }
     }
@@ -103,10 +139,15 @@ void TextMemoEditor::beginEdit()
     setReadOnly(false);
     toggleSpellcheck(true);
     _editor->setFocus();
+
+    _revision = _editor->document()->revision();
+    connect(_editor->document(), QOverload<int, int, int>::of(&QTextDocument::contentsChange), this, &TextMemoEditor::documentChanged);
 }
 
 void TextMemoEditor::endEdit()
 {
+    disconnect(_editor->document(), QOverload<int, int, int>::of(&QTextDocument::contentsChange), this, &TextMemoEditor::documentChanged);
+
     setReadOnly(true);
     toggleSpellcheck(false);
     _editor->document()->setModified(false);
@@ -26,6 +26,7 @@ public:
     virtual void setWordWrap(bool on) = 0;
     virtual void showMemo() = 0;
     virtual QString data() const = 0;
+    virtual void setData(const QString& data) = 0;
     virtual void setSpellcheckLang(const QString&) = 0;
     virtual QString spellcheckLang() const = 0;
     virtual void beginEdit() = 0;
@@ -35,6 +36,9 @@ public:
 signals:
     void onModified(bool modified);
 
+    /// Emitted while editing for each change of memo text, `inserted` is plain text.
+    void onChanged(int position, int removed, const QString& inserted);
+
 protected:
     explicit MemoEditor(MemoItem* memoItem, QWidget *parent = nullptr);
 
@@ -54,6 +58,7 @@ public:
     bool wordWrap() const override;
     void setWordWrap(bool on) override;
     QString data() const override;
+    void setData(const QString& data) override;
     void setSpellcheckLang(const QString& lang) override;
     QString spellcheckLang() const override { return _spellcheckLang; }
     void beginEdit() override;
@@ -69,10 +74,12 @@ protected:
     MemoTextEdit* _editor = nullptr;
     TextEditSpellcheck* _spellcheck = nullptr;
     QString _spellcheckLang;
+    int _revision = 0;
 
     void setEditor(MemoTextEdit*);
     void setReadOnly(bool on);
     void toggleSpellcheck(bool on);
+    void documentChanged(int position, int charsRemoved, int charsAdded);
 };
 
 #endif // MEMO_EDITOR_H
@@ -0,0 +1,102 @@
+#include "MemoHistoryPanel.h"
+
+#include "../catalog/Catalog.h"
+
+#include "helpers/OriLayouts.h"
+
+#include <QLabel>
+#include <QListWidget>
+#include <QPlainTextEdit>
+#include <QPushButton>
+
+MemoHistoryPanel::MemoHistoryPanel(Catalog* catalog, MemoItem* memoItem) : QWidget(),
+    _catalog(catalog), _memoItem(memoItem)
+{
+    _revisionsView = new QListWidget;
+    connect(_revisionsView, &QListWidget::currentRowChanged, this, &MemoHistoryPanel::revisionSelected);
+
+    // Plain text view is used because old revisions of big memos are shown much faster in it
+    _textView = new QPlainTextEdit;
+    _textView->setReadOnly(true);
+    _textView->setProperty("role", "memo_editor");
+
+    _statusLabel = new QLabel;
+
+    _restoreButton = new QPushButton(tr("Restore"));
+    _restoreButton->setToolTip(tr("Open the memo for editing with the text of the selected revision"));
+    _restoreButton->setEnabled(false);
+    connect(_restoreButton, &QPushButton::clicked, this, &MemoHistoryPanel::restore);
+
+    // Revisions are added by memo saving, which happens in background
+    connect(_catalog, &Catalog::memoUpdated, this, &MemoHistoryPanel::memoUpdated);
+
+    auto bottomPanel = new QWidget;
+    Ori::Layouts::LayoutH({_statusLabel, Ori::Layouts::Stretch(), _restoreButton}).setMargin(0).useFor(bottomPanel);
+
+    Ori::Layouts::LayoutV({_revisionsView, _textView, bottomPanel}).setMargin(0).setSpacing(4).useFor(this);
+}
+
+void MemoHistoryPanel::setTextFont(const QFont& font)
+{
+    _textView->setFont(font);
+}
+
+void MemoHistoryPanel::reload()
+{
+    _revisionsView->clear();
+    _textView->clear();
+    _restoreButton->setEnabled(false);
+
+    auto result = _catalog->memoRevisions(_memoItem);
+    if (!result.error.isEmpty())
+    {
+        _statusLabel->setText(tr("Unable to load history"));
+        _statusLabel->setToolTip(result.error);
+        return;
+    }
+    _statusLabel->setToolTip(QString());
+
+    _revisions = result.revisions;
+    for (auto& revision : _revisions)
+        _revisionsView->addItem(tr("%1  %2 (%3 chars)")
+            .arg(revision.moment.toString(Qt::SystemLocaleShortDate), revision.title).arg(revision.dataSize));
+
+    _statusLabel->setText(_revisions.isEmpty() ? tr("There are no previous revisions")
+                                               : tr("Revisions: %1").arg(_revisions.size()));
+}
+
+void MemoHistoryPanel::revisionSelected()
+{
+    int row = _revisionsView->currentRow();
+    if (row < 0 || row >= _revisions.size())
+    {
+        _textView->clear();
+        _restoreButton->setEnabled(false);
+        return;
+    }
+
+    QString data;
+    auto res = _catalog->loadRevision(_memoItem, _revisions.at(row).id, data);
+    if (!res.isEmpty())
+    {
+        _textView->setPlainText(res);
+        _restoreButton->setEnabled(false);
+        return;
+    }
+    _textView->setPlainText(data);
+    _restoreButton->setEnabled(true);
+}
+
+void MemoHistoryPanel::restore()
+{
+    int row = _revisionsView->currentRow();
+    if (row < 0 || row >= _revisions.size()) return;
+
+    emit onRestore(_revisions.at(row).title, _textView->toPlainText());
+}
+
+void MemoHistoryPanel::memoUpdated(MemoItem* item)
+{
+    if (item == _memoItem && isVisible())
+        reload();
+}
@@ -0,0 +1,46 @@
+#ifndef MEMO_HISTORY_PANEL_H
+#define MEMO_HISTORY_PANEL_H
+
+#include "../catalog/HistoryManager.h"
+
+#include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QLabel;
+class QListWidget;
+class QPlainTextEdit;
+class QPushButton;
+QT_END_NAMESPACE
+
+class Catalog;
+class MemoItem;
+
+/// Shows previous revisions of a memo and allows to take one of them back.
+class MemoHistoryPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MemoHistoryPanel(Catalog* catalog, MemoItem* memoItem);
+
+    void reload();
+    void setTextFont(const QFont& font);
+
+signals:
+    void onRestore(const QString& title, const QString& data);
+
+private:
+    Catalog* _catalog;
+    MemoItem* _memoItem;
+    QVector<MemoRevision> _revisions;
+    QListWidget* _revisionsView;
+    QPlainTextEdit* _textView;
+    QLabel* _statusLabel;
+    QPushButton* _restoreButton;
+
+    void revisionSelected();
+    void restore();
+    void memoUpdated(MemoItem* item);
+};
+
+#endif // MEMO_HISTORY_PANEL_H
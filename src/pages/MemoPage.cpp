@@ -1,10 +1,11 @@
 #include "MemoPage.h"
 
+#include "MemoHistoryPanel.h"
 #include "PageWidgets.h"
 #include "../editors/MarkdownMemoEditor.h"
 #include "../editors/PlainTextMemoEditor.h"
 #include "../catalog/Catalog.h"
-#include "../catalog/CatalogStore.h"
+#include "../catalog/RecoveryJournal.h"
 
 #include "helpers/OriDialogs.h"
 #include "helpers/OriWidgets.h"
@@ -12,6 +13,7 @@
 #include <QIcon>
 #include <QDebug>
 #include <QMessageBox>
+#include <QSplitter>
 #include <QToolButton>
 
 namespace {
@@ -33,19 +35,15 @@ namespace MemoOptions {
     const QString SPELLCHECK = "spellcheck";
     const QString HIGHLIGHTER = "highlighter";
 };
-
-void updateOption(MemoItem* memo, const QString& name, const QVariant& value)
-{
-    QString res = CatalogStore::memoManager()->updateOption(memo->id(), name, value);
-    if (!res.isEmpty())
-        Ori::Dlg::error(QString("Unable to store memo option in catalog.\n\n%1").arg(res));
-}
 }
 
 
 MemoPage::MemoPage(Catalog *catalog, MemoItem *memoItem) : QWidget(),
-    _catalog(catalog), _memoItem(memoItem)
+    _catalog(catalog), _memoItem(memoItem), _memoId(memoItem->id())
 {
+    // Text of an opened memo must not be unloaded by the memo cache
+    _catalog->memoCache().pin(_memoId);
+
     auto memoType = _memoItem->type();
 
     setWindowIcon(memoType->icon());
@@ -55,9 +53,11 @@ MemoPage::MemoPage(Catalog *catalog, MemoItem *memoItem) : QWidget(),
     else
         _memoEditor = new PlainTextMemoEditor(_memoItem);
     connect(_memoEditor, &MemoEditor::onModified, this, &MemoPage::onModified);
+    connect(_memoEditor, &MemoEditor::onChanged, this, &MemoPage::memoChanged);
+    connect(_catalog, &Catalog::memoUpdated, this, &MemoPage::memoUpdated);
 
     _titleEditor = PageWidgets::makeTitleEditor();
-    connect(_titleEditor, &QLineEdit::textEdited, [this]{ emit onModified(true); });
+    connect(_titleEditor, &QLineEdit::textEdited, this, &MemoPage::titleChanged);
 
     _toolbar = new QToolBar;
     _toolbar->setObjectName("memo_toolbar");
@@ -71,13 +71,20 @@ MemoPage::MemoPage(Catalog *catalog, MemoItem *memoItem) : QWidget(),
     _actionSave->setShortcut(QKeySequence::Save);
     _actionCancel->setShortcut(QKeySequence(Qt::Key_Escape, Qt::Key_Escape));
     _toolbar->addSeparator();
+    _actionHistory = _toolbar->addAction(tr("History"));
+    _actionHistory->setToolTip(tr("Show previous revisions of the memo"));
+    _actionHistory->setCheckable(true);
+    connect(_actionHistory, &QAction::toggled, this, &MemoPage::toggleHistory);
     _toolbar->addAction(QIcon(":/toolbar/close"), tr("Close"), [this](){
         if (canClose()) deleteLater();
     });
 
     auto toolPanel = PageWidgets::makeHeaderPanel({_titleEditor, _toolbar});
 
-    Ori::Layouts::LayoutV({toolPanel, _memoEditor}).setMargin(0).setSpacing(0).useFor(this);
+    _splitter = new QSplitter;
+    _splitter->addWidget(_memoEditor);
+
+    Ori::Layouts::LayoutV({toolPanel, _splitter}).setMargin(0).setSpacing(0).useFor(this);
 
     showMemo();
     toggleEditMode(false);
@@ -86,6 +93,15 @@ MemoPage::MemoPage(Catalog *catalog, MemoItem *memoItem) : QWidget(),
 
 MemoPage::~MemoPage()
 {
+    // Pages are deleted later than the catalog when the catalog is closed
+    if (_catalog)
+    {
+        _catalog->memoCache().unpin(_memoId);
+
+        // Changes have been discarded by user
+        if (_isEditMode)
+            discardEdit();
+    }
 }
 
 void MemoPage::showMemo()
@@ -114,6 +130,17 @@ bool MemoPage::canClose()
 }
 
 void MemoPage::beginEdit()
+{
+    enterEditMode();
+
+    // While the previous save is being written, its journal entry goes on,
+    // so the journal still has the whole text if the writing fails
+    _continuesSave = _catalog->isMemoSaving(_memoItem);
+    if (!_continuesSave)
+        _catalog->recoveryJournal()->beginMemo(_memoId, _titleEditor->text(), _memoEditor->data());
+}
+
+void MemoPage::enterEditMode()
 {
     toggleEditMode(true);
     _memoEditor->beginEdit();
@@ -122,25 +149,55 @@ void MemoPage::beginEdit()
 
 void MemoPage::cancelEdit()
 {
+    discardEdit();
     toggleEditMode(false);
     _memoEditor->endEdit();
     showMemo();
     emit onReadOnly(true);
 }
 
+/// Drops changes made in the editor from the recovery journal.
+/// The memo can have a text that has failed to be saved, it's discarded too.
+void MemoPage::discardEdit()
+{
+    auto journal = _catalog->recoveryJournal();
+    if (_continuesSave && _catalog->isMemoSaving(_memoItem))
+    {
+        // The entry still belongs to the text being written, so the changes are rolled back in it
+        journal->changeMemo(_memoId, 0, _memoEditor->data().size(), _memoItem->data());
+        journal->changeTitle(_memoId, _memoItem->title());
+    }
+    else
+    {
+        journal->endMemo(_memoId);
+
+        auto res = _catalog->revertMemo(_memoItem);
+        if (!res.isEmpty())
+            qWarning() << "Failed to reload memo" << _memoId << res;
+    }
+    _continuesSave = false;
+}
+
 bool MemoPage::saveEdit()
 {
     MemoUpdateParam update;
     update.title = _titleEditor->text().trimmed();
     update.data = _memoEditor->data();
 
-    auto res = _catalog->updateMemo(_memoItem, update);
+    // The memo is written in background, a failure is reported by the catalog later
+    auto res = _catalog->saveMemo(_memoItem, update);
     if (!res.isEmpty())
     {
         Ori::Dlg::error(res);
         return false;
     }
 
+    // The journal entry is ended by the catalog when the memo is written,
+    // it's written at once only inside of a batch
+    if (!_catalog->isMemoSaving(_memoItem))
+        _catalog->recoveryJournal()->endMemo(_memoId);
+    _continuesSave = false;
+
     _memoEditor->saveEdit();
     _titleEditor->setModified(false);
     setWindowTitle(_memoItem->title());
@@ -149,6 +206,117 @@ bool MemoPage::saveEdit()
     return true;
 }
 
+/// Opens the memo for editing with the text it had before the previous session crashed.
+QString MemoPage::recoverEdit(const RecoveredMemo& memo)
+{
+    if (_isEditMode)
+        return tr("Memo is being edited.");
+
+    // Editor's text is taken as the base, not the memo data,
+    // because changes were recorded against the text in the editor.
+    beginEdit();
+
+    QString text;
+    auto res = memo.restoreText(_memoEditor->data(), text);
+    if (!res.isEmpty())
+    {
+        cancelEdit();
+        return res;
+    }
+
+    // Recovered text is stored in the new journal as a single change,
+    // so it can be restored again if the program crashes before the memo is saved.
+    _memoEditor->setData(text);
+    if (memo.title != _titleEditor->text())
+    {
+        _titleEditor->setText(memo.title);
+        titleChanged();
+    }
+    _titleEditor->setModified(true);
+    emit onModified(true);
+    return QString();
+}
+
+/// Opens the memo for editing again after its saving has failed.
+/// The text that was not saved is kept by the catalog and marked as modified in the editor,
+/// so it isn't lost when the page is closed. The journal entry of the failed save is continued.
+void MemoPage::restoreFailedEdit()
+{
+    _continuesSave = false;
+    if (!_isEditMode)
+    {
+        enterEditMode();
+        _memoEditor->setData(_memoItem->data());
+        _titleEditor->setText(_memoItem->title());
+    }
+    _titleEditor->setModified(true);
+    emit onModified(true);
+}
+
+void MemoPage::memoChanged(int position, int removed, const QString& inserted)
+{
+    _catalog->recoveryJournal()->changeMemo(_memoId, position, removed, inserted);
+}
+
+void MemoPage::titleChanged()
+{
+    if (_isEditMode)
+        _catalog->recoveryJournal()->changeTitle(_memoId, _titleEditor->text());
+    emit onModified(true);
+}
+
+void MemoPage::memoUpdated(MemoItem* item)
+{
+    if (item != _memoItem || !_continuesSave) return;
+    _continuesSave = false;
+    if (!_isEditMode) return;
+
+    // The catalog has ended the journal entry of the written text,
+    // changes made after the save are stored against that text in a new entry
+    auto journal = _catalog->recoveryJournal();
+    journal->beginMemo(_memoId, _memoItem->title(), _memoItem->data());
+    journal->changeMemo(_memoId, 0, _memoItem->data().size(), _memoEditor->data());
+    if (_titleEditor->text() != _memoItem->title())
+        journal->changeTitle(_memoId, _titleEditor->text());
+}
+
+void MemoPage::toggleHistory(bool on)
+{
+    if (on && !_historyPanel)
+    {
+        _historyPanel = new MemoHistoryPanel(_catalog, _memoItem);
+        connect(_historyPanel, &MemoHistoryPanel::onRestore, this, &MemoPage::restoreRevision);
+        _splitter->addWidget(_historyPanel);
+    }
+    if (!_historyPanel) return;
+
+    // History is read only when it's shown, it's not needed for most of opened memos
+    if (on)
+    {
+        _historyPanel->setTextFont(_memoEditor->font());
+        _historyPanel->reload();
+    }
+    _historyPanel->setVisible(on);
+}
+
+void MemoPage::restoreRevision(const QString& title, const QString& data)
+{
+    if (isModified() && !Ori::Dlg::yes(tr("<b>%1</b><br/><br/>"
+                                          "This memo has been changed. "
+                                          "Replace the changes with the selected revision?")
+                                       .arg(windowTitle())))
+        return;
+
+    if (!_isEditMode)
+        beginEdit();
+
+    // The revision is not saved until user saves the memo, so it can be reviewed before
+    _memoEditor->setData(data);
+    _titleEditor->setText(title);
+    _titleEditor->setModified(true);
+    titleChanged();
+}
+
 void MemoPage::toggleEditMode(bool on)
 {
     _isEditMode = on;
@@ -197,7 +365,7 @@ QFont MemoPage::memoFont() const
 void MemoPage::setMemoFont(const QFont& font)
 {
     _memoEditor->setFont(font);
-    updateOption(_memoItem, MemoOptions::FONT, font.toString());
+    _catalog->setMemoOption(_memoItem->id(), MemoOptions::FONT, font.toString());
 }
 
 bool MemoPage::wordWrap() const
@@ -208,7 +376,7 @@ bool MemoPage::wordWrap() const
 void MemoPage::setWordWrap(bool wrap)
 {
     _memoEditor->setWordWrap(wrap);
-    updateOption(_memoItem, MemoOptions::WORD_WRAP, wrap);
+    _catalog->setMemoOption(_memoItem->id(), MemoOptions::WORD_WRAP, wrap);
 }
 
 bool MemoPage::isModified() const
@@ -219,7 +387,7 @@ bool MemoPage::isModified() const
 void MemoPage::setSpellcheckLang(const QString &lang)
 {
     _memoEditor->setSpellcheckLang(lang);
-    updateOption(_memoItem, MemoOptions::SPELLCHECK, lang);
+    _catalog->setMemoOption(_memoItem->id(), MemoOptions::SPELLCHECK, lang);
 }
 
 QString MemoPage::spellcheckLang() const
@@ -233,7 +401,7 @@ void MemoPage::setHighlighter(const QString& name)
     if (editor)
     {
         editor->setHighlighterName(name);
-        updateOption(_memoItem, MemoOptions::HIGHLIGHTER, name);
+        _catalog->setMemoOption(_memoItem->id(), MemoOptions::HIGHLIGHTER, name);
     }
 }
 
@@ -255,7 +423,7 @@ void MemoPage::togglePreviewMode()
 
 void MemoPage::loadSettings()
 {
-    auto options = CatalogStore::memoManager()->selectOptions(_memoItem->id());
+    auto options = _catalog->memoOptions(_memoItem->id());
 
     auto memoFont = AppSettings::instance().memoFont;
     if (options.contains(MemoOptions::FONT))
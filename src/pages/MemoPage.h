@@ -1,11 +1,13 @@
 #ifndef MEMO_PAGE_H
 #define MEMO_PAGE_H
 
+#include <QPointer>
 #include <QWidget>
 
 QT_BEGIN_NAMESPACE
 class QAction;
 class QLineEdit;
+class QSplitter;
 class QSyntaxHighlighter;
 class QToolBar;
 class QToolButton;
@@ -13,7 +15,9 @@ QT_END_NAMESPACE
 
 class Catalog;
 class MemoEditor;
+class MemoHistoryPanel;
 class MemoItem;
+struct RecoveredMemo;
 
 class MemoPage : public QWidget
 {
@@ -44,6 +48,8 @@ public:
     bool isModified() const;
     bool isReadOnly() const { return !_isEditMode; }
     bool canClose();
+    QString recoverEdit(const RecoveredMemo& memo);
+    void restoreFailedEdit();
 
     void exportToPdf();
 
@@ -53,20 +59,31 @@ signals:
     void onModified(bool modified);
 
 private:
-    Catalog* _catalog;
+    QPointer<Catalog> _catalog;
     MemoItem* _memoItem;
+    int _memoId;
     MemoEditor* _memoEditor;
     QLineEdit* _titleEditor;
     QToolBar* _toolbar;
-    QAction *_actionEdit, *_actionSave, *_actionCancel;
+    QAction *_actionEdit, *_actionSave, *_actionCancel, *_actionHistory;
     QAction *_actionPreview = nullptr, *_actionPreviewButton, *_separatorPreview;
     QToolButton *_previewButton;
+    QSplitter* _splitter;
+    MemoHistoryPanel* _historyPanel = nullptr;
     bool _isEditMode = false;
+    bool _continuesSave = false;
 
     void showMemo();
     void cancelEdit();
+    void enterEditMode();
+    void discardEdit();
     void toggleEditMode(bool on);
     void togglePreviewMode();
+    void memoChanged(int position, int removed, const QString& inserted);
+    void titleChanged();
+    void memoUpdated(MemoItem* item);
+    void toggleHistory(bool on);
+    void restoreRevision(const QString& title, const QString& data);
 };
 
 #endif // MEMO_PAGE_H
@@ -0,0 +1,98 @@
+#include "SearchPage.h"
+
+#include "PageWidgets.h"
+#include "../catalog/Catalog.h"
+#include "helpers/OriLayouts.h"
+
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QTextBrowser>
+#include <QUrl>
+
+namespace {
+
+const QString MEMO_LINK_SCHEME = QStringLiteral("memo");
+
+QString formatSnippet(const QString& snippet)
+{
+    QString html = QString(snippet).replace('\n', ' ').toHtmlEscaped();
+    html.replace(SearchManager::matchBegin, QStringLiteral("<b style='background:#fff3a8'>"));
+    html.replace(SearchManager::matchEnd, QStringLiteral("</b>"));
+    return html;
+}
+
+} // namespace
+
+SearchPage::SearchPage(Catalog *catalog) : QWidget(), _catalog(catalog)
+{
+    setWindowTitle(tr("Search"));
+    setWindowIcon(QIcon(":/icon/main"));
+
+    _searchEditor = new QLineEdit;
+    _searchEditor->setPlaceholderText(tr("Type words to search and press Enter"));
+    connect(_searchEditor, &QLineEdit::returnPressed, this, &SearchPage::search);
+
+    _statusLabel = new QLabel;
+
+    _resultsView = new QTextBrowser;
+    _resultsView->setProperty("role", "memo_editor");
+    _resultsView->setOpenLinks(false);
+    connect(_resultsView, &QTextBrowser::anchorClicked, this, &SearchPage::linkClicked);
+
+    auto titleEditor = PageWidgets::makeTitleEditor(windowTitle());
+
+    auto toolbar = new QToolBar;
+    toolbar->addAction(QIcon(":/toolbar/close"), tr("Close"), [this](){
+        deleteLater();
+    });
+
+    auto toolPanel = PageWidgets::makeHeaderPanel({titleEditor, toolbar});
+
+    Ori::Layouts::LayoutV({toolPanel, _searchEditor, _statusLabel, _resultsView})
+            .setMargin(0).setSpacing(4).useFor(this);
+
+    _searchEditor->setFocus();
+}
+
+void SearchPage::search()
+{
+    QString text = _searchEditor->text().trimmed();
+    if (text.isEmpty()) return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    auto res = _catalog->searchMemos(text);
+    if (!res.error.isEmpty())
+    {
+        _statusLabel->setText(QString());
+        _resultsView->setHtml(QStringLiteral("<p style='color:red;white-space:pre'>%1")
+                              .arg(res.error.toHtmlEscaped()));
+        return;
+    }
+
+    QString html;
+    for (const SearchHit& hit : res.hits)
+    {
+        auto memo = _catalog->findMemoById(hit.memoId);
+        if (!memo) continue;
+
+        QString path = memo->path();
+        html += QStringLiteral("<p><a href='%1:%2'><b>%3</b></a>")
+                .arg(MEMO_LINK_SCHEME).arg(memo->id()).arg(memo->title().toHtmlEscaped());
+        if (!path.isEmpty())
+            html += QStringLiteral(" <span style='color:gray'>%1</span>").arg(path.toHtmlEscaped());
+        html += QStringLiteral("<br/>") + formatSnippet(hit.snippet) + QStringLiteral("</p>");
+    }
+    _resultsView->setHtml(html);
+
+    _statusLabel->setText(tr("Memos found: %1 (%2 ms)").arg(res.hits.size()).arg(timer.elapsed()));
+}
+
+void SearchPage::linkClicked(const QUrl& url)
+{
+    if (url.scheme() != MEMO_LINK_SCHEME) return;
+
+    auto memo = _catalog->findMemoById(url.path().toInt());
+    if (memo) emit onOpenMemo(memo);
+}
@@ -0,0 +1,36 @@
+#ifndef SEARCH_PAGE_H
+#define SEARCH_PAGE_H
+
+#include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QLabel;
+class QLineEdit;
+class QTextBrowser;
+class QUrl;
+QT_END_NAMESPACE
+
+class Catalog;
+class MemoItem;
+
+class SearchPage : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SearchPage(Catalog* catalog);
+
+signals:
+    void onOpenMemo(MemoItem* item);
+
+private:
+    Catalog* _catalog;
+    QLineEdit* _searchEditor;
+    QTextBrowser* _resultsView;
+    QLabel* _statusLabel;
+
+    void search();
+    void linkClicked(const QUrl& url);
+};
+
+#endif // SEARCH_PAGE_H
@@ -0,0 +1,75 @@
+#include "SpellcheckBlockData.h"
+
+#include "../TextEditHelpers.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QPainter>
+#include <QPainterPath>
+#include <QScrollBar>
+#include <QTextLayout>
+
+SpellcheckBlockData* SpellcheckBlockData::of(const QTextBlock& block)
+{
+    return dynamic_cast<SpellcheckBlockData*>(block.userData());
+}
+
+static void drawWave(QPainterPath& path, qreal x1, qreal x2, qreal y)
+{
+    const qreal halfPeriod = 2;
+    const qreal amplitude = 1;
+
+    path.moveTo(x1, y);
+    bool up = true;
+    for (qreal x = x1 + halfPeriod; x < x2 + halfPeriod; x += halfPeriod)
+    {
+        path.lineTo(qMin(x, x2), up ? y - amplitude : y + amplitude);
+        up = !up;
+    }
+}
+
+void SpellcheckBlockData::paintErrors(QTextEdit* editor, const QRect& rect)
+{
+    static QColor errorColor = TextFormat().spellError().get().underlineColor();
+
+    auto docLayout = editor->document()->documentLayout();
+    QPointF offset(-editor->horizontalScrollBar()->value(), -editor->verticalScrollBar()->value());
+
+    QPainterPath path;
+    auto block = editor->cursorForPosition(rect.topLeft()).block();
+    for (; block.isValid(); block = block.next())
+    {
+        if (docLayout->blockBoundingRect(block).translated(offset).top() > rect.bottom()) break;
+
+        auto data = of(block);
+        if (!data || data->errors.isEmpty() || data->length != block.length()) continue;
+
+        auto layout = block.layout();
+        QPointF origin = layout->position() + offset;
+        for (auto& error : data->errors)
+        {
+            // A misspelled word can be wrapped to several lines
+            int pos = error.first;
+            int stop = error.first + error.second;
+            while (pos < stop)
+            {
+                auto line = layout->lineForTextPosition(pos);
+                if (!line.isValid()) break;
+
+                int lineStop = qMin(stop, line.textStart() + line.textLength());
+                if (lineStop <= pos) break;
+
+                qreal y = origin.y() + line.y() + line.ascent() + 2;
+                drawWave(path, origin.x() + line.cursorToX(pos), origin.x() + line.cursorToX(lineStop), y);
+                pos = lineStop;
+            }
+        }
+    }
+
+    if (path.isEmpty()) return;
+
+    QPainter painter(editor->viewport());
+    painter.setClipRect(rect);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(errorColor, 1));
+    painter.drawPath(path);
+}
@@ -0,0 +1,41 @@
+#ifndef SPELLCHECK_BLOCK_DATA_H
+#define SPELLCHECK_BLOCK_DATA_H
+
+#include <QPair>
+#include <QTextBlock>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QRect;
+class QTextEdit;
+QT_END_NAMESPACE
+
+/// Spelling errors found in a text block.
+/// Errors are not stored as text formats or extra selections of the editor:
+/// formats are overwritten by syntax highlighter and the whole list of extra selections
+/// has to be reset on any change, it is slow when there are thousands of errors.
+class SpellcheckBlockData : public QTextBlockUserData
+{
+public:
+    /// Starts and lengths of misspelled words relative to the block start.
+    QVector<QPair<int, int>> errors;
+
+    /// Block length for which errors are valid,
+    /// it is used to detect that the block has been split or merged with another one.
+    int length = 0;
+
+    /// The block is changed after it was checked.
+    bool dirty = true;
+
+    /// Document revision at which the block has been sent for checking.
+    /// When the document is changed, the result becomes stale and the block should be sent again.
+    int requestedRevision = -1;
+
+    static SpellcheckBlockData* of(const QTextBlock& block);
+
+    /// Draws wavy underlines under misspelled words in visible blocks.
+    /// It should be called after the editor has painted its content.
+    static void paintErrors(QTextEdit* editor, const QRect& rect);
+};
+
+#endif // SPELLCHECK_BLOCK_DATA_H
@@ -0,0 +1,213 @@
+#include "SpellcheckEngine.h"
+
+#include "Spellchecker.h"
+
+#include <QSet>
+#include <QThread>
+
+#include <algorithm>
+
+// The same characters break words when QTextCursor moves by words,
+// so the text is split in the same way as it is split in the editor.
+static bool isWordSeparator(const QChar& ch)
+{
+    switch (ch.unicode())
+    {
+    case '.': case ',': case '?': case '!': case '@': case '#': case '$':
+    case ':': case ';': case '-': case '<': case '>': case '[': case ']':
+    case '(': case ')': case '{': case '}': case '=': case '/': case '+':
+    case '%': case '&': case '^': case '*': case '\'': case '"': case '`':
+    case '~': case '|': case '\\':
+        return true;
+    }
+    return ch.isSpace() || ch == QChar::ObjectReplacementCharacter;
+}
+
+static bool isWordChar(const QChar& ch)
+{
+    return ch.isLetter() || ch.isDigit();
+}
+
+//------------------------------------------------------------------------------
+//                              SpellcheckWorker
+//------------------------------------------------------------------------------
+
+SpellcheckWorker::SpellcheckWorker(Spellchecker* spellchecker, int index)
+    : QObject(), _spellchecker(spellchecker), _index(index)
+{
+}
+
+void SpellcheckWorker::check(const SpellcheckRequest& request)
+{
+    QVector<SpellcheckWord> words;
+
+    const QString& text = request.text;
+    const int size = text.size();
+    int skipIndex = 0;
+    int pos = 0;
+    while (pos < size)
+    {
+        while (pos < size && isWordSeparator(text.at(pos))) pos++;
+        int start = pos;
+        while (pos < size && !isWordSeparator(text.at(pos))) pos++;
+        int stop = pos;
+
+        // Quotes like &raquo; or &rdquo; are not separators, they become a part of the word.
+        // Remove such punctuation at word boundaries.
+        while (start < stop && !isWordChar(text.at(start))) start++;
+        while (stop > start && !isWordChar(text.at(stop - 1))) stop--;
+
+        // Skip one-letter words
+        //
+        // TODO: currently, abbreviations such as "e.i.", "e.g.", "т.д.", "т.п."
+        // are splitted to series of one-letter words and therefore skipped.
+        // It allows mixing of such words in different languages,
+        // e.g. one can use "т.д." in a text in English, it's not ok.
+        //
+        // Similar issue with words like "doesn't" - it splitted into "doesn" and "t",
+        // "t" is skipped and "doesn" gives spelling error. Checking is ok when
+        // true apostrophe character is used (’ = U+2019). But it's not the case
+        // when one type memos via keyboard - single quote is generally used as apostrophe.
+        //
+        // It'd be better to check such words as a whole.
+        //
+        if (stop - start < 2) continue;
+
+        while (skipIndex < request.skipped.size() &&
+               request.skipped.at(skipIndex).first + request.skipped.at(skipIndex).second <= start)
+            skipIndex++;
+        if (skipIndex < request.skipped.size() && request.skipped.at(skipIndex).first < stop)
+            continue;
+
+        QString word = text.mid(start, stop - start);
+        if (_spellchecker->handles(word))
+            words.append({ start, stop - start, _spellchecker->check(word) });
+    }
+
+    emit checked(request.id, _index, words);
+}
+
+//------------------------------------------------------------------------------
+//                              SpellcheckEngine
+//------------------------------------------------------------------------------
+
+SpellcheckEngine::SpellcheckEngine(const QList<Spellchecker*>& spellcheckers, QObject* parent)
+    : QObject(parent), _spellcheckers(spellcheckers)
+{
+    qRegisterMetaType<SpellcheckRequest>();
+    qRegisterMetaType<SpellcheckResult>();
+    qRegisterMetaType<QVector<SpellcheckWord>>();
+
+    for (int i = 0; i < _spellcheckers.size(); i++)
+    {
+        auto worker = new SpellcheckWorker(_spellcheckers.at(i), i);
+        auto thread = new QThread(this);
+        worker->moveToThread(thread);
+
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        connect(this, &SpellcheckEngine::checkRequested, worker, &SpellcheckWorker::check);
+        connect(worker, &SpellcheckWorker::checked, this, &SpellcheckEngine::workerChecked);
+
+        thread->start();
+        _threads << thread;
+    }
+}
+
+SpellcheckEngine::~SpellcheckEngine()
+{
+    // Requests not started yet are dropped, only the current ones are waited for
+    for (auto thread : _threads)
+        thread->quit();
+    for (auto thread : _threads)
+        thread->wait();
+}
+
+void SpellcheckEngine::check(const SpellcheckRequest& request)
+{
+    PendingRequest pending;
+    pending.request = request;
+    pending.request.id = ++_lastRequestId;
+    pending.words.resize(_spellcheckers.size());
+    _pending.insert(pending.request.id, pending);
+
+    emit checkRequested(pending.request);
+}
+
+void SpellcheckEngine::workerChecked(int requestId, int index, const QVector<SpellcheckWord>& words)
+{
+    auto it = _pending.find(requestId);
+    if (it == _pending.end()) return;
+
+    it->words[index] = words;
+    if (++it->answerCount < _spellcheckers.size()) return;
+
+    auto result = makeResult(it.value());
+    _pending.erase(it);
+    emit checked(result);
+}
+
+SpellcheckResult SpellcheckEngine::makeResult(const PendingRequest& pending) const
+{
+    const SpellcheckRequest& request = pending.request;
+
+    SpellcheckResult result;
+    result.revision = request.revision;
+    result.position = request.position;
+    result.length = request.text.size();
+
+    // Paragraphs are separated in the same way as blocks of the document
+    QVector<int> paragraphStops;
+    for (int i = 0; i < request.text.size(); i++)
+        if (request.text.at(i) == QChar::ParagraphSeparator)
+            paragraphStops << i;
+    paragraphStops << request.text.size();
+    auto paragraphOf = [&paragraphStops](int pos) {
+        return int(std::lower_bound(paragraphStops.begin(), paragraphStops.end(), pos) - paragraphStops.begin());
+    };
+
+    // Number of recognized words in each paragraph for each dictionary
+    int dictCount = _spellcheckers.size();
+    QVector<QVector<int>> correctCounts(dictCount, QVector<int>(paragraphStops.size(), 0));
+    for (int i = 0; i < dictCount; i++)
+        for (auto& word : pending.words.at(i))
+            if (word.correct)
+                correctCounts[i][paragraphOf(word.start)]++;
+
+    // Words accepted by dictionaries of a known script, other dictionaries can't argue with them
+    QSet<int> acceptedStarts;
+    for (int i = 0; i < dictCount; i++)
+        if (_spellcheckers.at(i)->script() != QChar::Script_Unknown)
+            for (auto& word : pending.words.at(i))
+                if (word.correct)
+                    acceptedStarts.insert(word.start);
+
+    for (int i = 0; i < dictCount; i++)
+    {
+        auto script = _spellcheckers.at(i)->script();
+        for (auto& word : pending.words.at(i))
+        {
+            if (word.correct) continue;
+            if (script == QChar::Script_Unknown && acceptedStarts.contains(word.start)) continue;
+
+            // Verdict is taken from the dictionary which is the best for the paragraph among ones of the same script
+            int paragraph = paragraphOf(word.start);
+            bool isParagraphLang = true;
+            for (int j = 0; j < dictCount && isParagraphLang; j++)
+                if (j != i && _spellcheckers.at(j)->script() == script)
+                {
+                    int count = correctCounts.at(j).at(paragraph);
+                    int ownCount = correctCounts.at(i).at(paragraph);
+                    if (count > ownCount || (count == ownCount && j < i))
+                        isParagraphLang = false;
+                }
+
+            if (isParagraphLang)
+                result.errors.append(qMakePair(request.position + word.start, word.length));
+        }
+    }
+
+    // Dictionaries of unknown script check all words, so the same word can be reported twice
+    std::sort(result.errors.begin(), result.errors.end());
+    result.errors.erase(std::unique(result.errors.begin(), result.errors.end()), result.errors.end());
+    return result;
+}
@@ -0,0 +1,131 @@
+#ifndef SPELLCHECK_ENGINE_H
+#define SPELLCHECK_ENGINE_H
+
+#include <QList>
+#include <QMap>
+#include <QMetaType>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class Spellchecker;
+
+/// Piece of document text to be checked.
+struct SpellcheckRequest
+{
+    /// Identifier of the request, it is assigned by the engine.
+    int id;
+
+    /// Revision of the document the text is taken from.
+    int revision;
+
+    /// Document position of the first character of the text.
+    int position;
+
+    QString text;
+
+    /// Ranges which should not be checked, e.g. hyperlinks.
+    /// Starts are relative to the text start, ranges are sorted by start.
+    QVector<QPair<int, int>> skipped;
+};
+
+struct SpellcheckResult
+{
+    int revision;
+
+    /// Document range which has been checked.
+    int position;
+    int length;
+
+    /// Document positions and lengths of misspelled words.
+    QVector<QPair<int, int>> errors;
+};
+
+/// Word checked by one of dictionaries, the start is relative to the request text.
+struct SpellcheckWord
+{
+    int start;
+    int length;
+    bool correct;
+};
+
+Q_DECLARE_TYPEINFO(SpellcheckWord, Q_PRIMITIVE_TYPE);
+
+Q_DECLARE_METATYPE(SpellcheckRequest)
+Q_DECLARE_METATYPE(SpellcheckResult)
+Q_DECLARE_METATYPE(QVector<SpellcheckWord>)
+
+//------------------------------------------------------------------------------
+
+/// Splits texts into words and checks ones written in the script of its dictionary.
+/// Each dictionary has its own worker living in its own thread.
+class SpellcheckWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    SpellcheckWorker(Spellchecker* spellchecker, int index);
+
+    void check(const SpellcheckRequest& request);
+
+signals:
+    void checked(int requestId, int index, const QVector<SpellcheckWord>& words);
+
+private:
+    Spellchecker* _spellchecker;
+    int _index;
+};
+
+//------------------------------------------------------------------------------
+
+/// Checks spelling of text snapshots without blocking the GUI thread.
+/// Requests are processed one by one in the order they are made.
+/// The document can be changed while a request is processed, so a receiver
+/// has to compare revision of the result with the current document revision.
+///
+/// When there are several dictionaries, each of them checks the text in parallel.
+/// Words are routed to dictionaries by their script. When several dictionaries
+/// use the same script, the language of each paragraph is the one recognizing
+/// the most words in the paragraph, and only its verdicts are taken into account.
+/// The first dictionary wins when they recognize the same number of words.
+/// Dictionaries of unknown script check all words, but their errors are dropped
+/// for words accepted by a dictionary of a known script.
+class SpellcheckEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpellcheckEngine(const QList<Spellchecker*>& spellcheckers, QObject* parent = nullptr);
+    ~SpellcheckEngine() override;
+
+    void check(const SpellcheckRequest& request);
+
+signals:
+    void checked(const SpellcheckResult& result);
+
+    /// Passes a request to the worker thread, it is not intended to be used outside.
+    void checkRequested(const SpellcheckRequest& request);
+
+private:
+    struct PendingRequest
+    {
+        SpellcheckRequest request;
+        int answerCount = 0;
+        QVector<QVector<SpellcheckWord>> words;
+    };
+
+    QList<Spellchecker*> _spellcheckers;
+    QList<QThread*> _threads;
+    QMap<int, PendingRequest> _pending;
+    int _lastRequestId = 0;
+
+    void workerChecked(int requestId, int index, const QVector<SpellcheckWord>& words);
+    SpellcheckResult makeResult(const PendingRequest& pending) const;
+};
+
+#endif // SPELLCHECK_ENGINE_H
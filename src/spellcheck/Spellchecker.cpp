@@ -9,6 +9,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QMenu>
+#include <QMutexLocker>
 #include <QTextCodec>
 
 #include "tools/OriSettings.h"
@@ -22,6 +23,9 @@ QMap<QString, QString> langNamesMap();
 static const QString dictFileExt(".dic");
 static const QString affixFileExt(".aff");
 
+// Max number of words remembered by each spellchecker
+static const int WORD_CACHE_SIZE = 50000;
+
 static QDir dictionaryDir()
 {
     QDir dir(qApp->applicationDirPath() + "/dicts");
@@ -78,11 +82,49 @@ static QString dictionaryEncoding(const QString& affixFilePath)
     return encoding;
 }
 
+static QMap<QString, Spellchecker*>& spellcheckers()
+{
+    static QMap<QString, Spellchecker*> checkers;
+    return checkers;
+}
+
+// Detects script of the dictionary by letters of the TRY option in the affix file
+static QChar::Script dictionaryScript(const QString& affixFilePath, QTextCodec* codec)
+{
+    QFile file(affixFilePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open affix file" << affixFilePath << file.errorString();
+        return QChar::Script_Unknown;
+    }
+    QMap<QChar::Script, int> counts;
+    while (!file.atEnd())
+    {
+        QByteArray line = file.readLine().trimmed();
+        if (!line.startsWith("TRY")) continue;
+
+        for (auto ch : codec->toUnicode(line.mid(3)))
+            if (ch.isLetter())
+                counts[ch.script()]++;
+        break;
+    }
+    file.close();
+    QChar::Script script = QChar::Script_Unknown;
+    int maxCount = 0;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); it++)
+        if (it.value() > maxCount)
+        {
+            script = it.key();
+            maxCount = it.value();
+        }
+    return script;
+}
+
 Spellchecker* Spellchecker::get(const QString& lang)
 {
     if (lang.isEmpty()) return nullptr;
 
-    static QMap<QString, Spellchecker*> checkers;
+    auto& checkers = spellcheckers();
 
     if (!checkers.contains(lang))
     {
@@ -118,10 +160,34 @@ Spellchecker* Spellchecker::get(const QString& lang)
     return checkers[lang];
 }
 
+QList<Spellchecker*> Spellchecker::loaded()
+{
+    return spellcheckers().values();
+}
+
+QStringList Spellchecker::splitLangs(const QString& langs)
+{
+    return langs.split(',', QString::SkipEmptyParts);
+}
+
+QString Spellchecker::joinLangs(const QStringList& langs)
+{
+    return langs.join(',');
+}
+
+QChar::Script Spellchecker::wordScript(const QString& word)
+{
+    for (auto ch : word)
+        if (ch.isLetter())
+            return ch.script();
+    return QChar::Script_Unknown;
+}
+
 
 Spellchecker::Spellchecker(const QString &dictFilePath, const QString& affixFilePath, const QString &userDictionaryPath)
 {
     _userDictionaryPath = userDictionaryPath;
+    _cache.setMaxCost(WORD_CACHE_SIZE);
 
     QString encoding = dictionaryEncoding(affixFilePath);
     if (encoding.isEmpty())
@@ -143,6 +209,8 @@ Spellchecker::Spellchecker(const QString &dictFilePath, const QString& affixFile
     _hunspell = new Hunspell(affixFilePath.toLocal8Bit().constData(),
                              dictFilePath.toLocal8Bit().constData());
 
+    _script = dictionaryScript(affixFilePath, _codec);
+
     loadUserDictionary();
 }
 
@@ -153,12 +221,36 @@ Spellchecker::~Spellchecker()
 
 bool Spellchecker::check(const QString &word) const
 {
-    return _hunspell->spell(_codec->fromUnicode(word).toStdString());
+    QMutexLocker locker(&_mutex);
+
+    auto cached = _cache.object(word);
+    if (cached)
+    {
+        _cacheStats.hits++;
+        return *cached;
+    }
+    _cacheStats.misses++;
+
+    bool ok = _hunspell->spell(_codec->fromUnicode(word).toStdString());
+    _cache.insert(word, new bool(ok));
+    return ok;
+}
+
+bool Spellchecker::handles(const QString& word) const
+{
+    if (_script == QChar::Script_Unknown) return true;
+    return wordScript(word) == _script;
 }
 
 void Spellchecker::ignore(const QString &word)
 {
-    _hunspell->add(_codec->fromUnicode(word).toStdString());
+    {
+        QMutexLocker locker(&_mutex);
+        _hunspell->add(_codec->fromUnicode(word).toStdString());
+
+        // Hunspell also accepts capitalized forms of the added word, so not only its verdict is changed
+        _cache.clear();
+    }
     emit wordIgnored(word);
 }
 
@@ -166,6 +258,8 @@ void Spellchecker::save(const QString &word)
 {
     if (_userDictionaryPath.isEmpty()) return;
 
+    clearCache();
+
     QFile file(_userDictionaryPath);
     if (!file.open(QIODevice::Append))
     {
@@ -182,12 +276,27 @@ void Spellchecker::save(const QString &word)
 
 QStringList Spellchecker::suggest(const QString &word) const
 {
+    QMutexLocker locker(&_mutex);
     QStringList variants;
     for (auto variant : _hunspell->suggest(_codec->fromUnicode(word).toStdString()))
         variants << _codec->toUnicode(QByteArray::fromStdString(variant));
     return variants;
 }
 
+SpellcheckCacheStats Spellchecker::cacheStats() const
+{
+    QMutexLocker locker(&_mutex);
+    SpellcheckCacheStats stats = _cacheStats;
+    stats.size = _cache.size();
+    return stats;
+}
+
+void Spellchecker::clearCache()
+{
+    QMutexLocker locker(&_mutex);
+    _cache.clear();
+}
+
 void Spellchecker::loadUserDictionary()
 {
     if (_userDictionaryPath.isEmpty()) return;
@@ -217,8 +326,9 @@ SpellcheckControl::SpellcheckControl(QObject* parent) : QObject(parent)
     auto dicts = dictionaries();
     if (dicts.isEmpty()) return;
 
+    // Several dictionaries can be used at once, so dictionary actions are not exclusive
     _actionGroup = new QActionGroup(parent);
-    _actionGroup->setExclusive(true);
+    _actionGroup->setExclusive(false);
     connect(_actionGroup, &QActionGroup::triggered, this, &SpellcheckControl::actionGroupTriggered);
 
     auto actionNone = new QAction(tr("None"), this);
@@ -249,12 +359,12 @@ void SpellcheckControl::showCurrentLang(const QString& lang)
 {
     if (!_actionGroup) return;
 
+    _currentLangs = Spellchecker::splitLangs(lang);
     for (auto action : _actionGroup->actions())
-        if (action->data().toString() == lang)
-        {
-            action->setChecked(true);
-            break;
-        }
+    {
+        auto actionLang = action->data().toString();
+        action->setChecked(actionLang.isEmpty() ? _currentLangs.isEmpty() : _currentLangs.contains(actionLang));
+    }
 }
 
 void SpellcheckControl::setEnabled(bool on)
@@ -264,5 +374,17 @@ void SpellcheckControl::setEnabled(bool on)
 
 void SpellcheckControl::actionGroupTriggered(QAction* action)
 {
-    emit langSelected(action->data().toString());
+    // Languages are kept in order of selection, so the main language stays first
+    auto lang = action->data().toString();
+    if (lang.isEmpty())
+        _currentLangs.clear();
+    else if (action->isChecked())
+    {
+        if (!_currentLangs.contains(lang))
+            _currentLangs << lang;
+    }
+    else _currentLangs.removeAll(lang);
+
+    showCurrentLang(Spellchecker::joinLangs(_currentLangs));
+    emit langSelected(Spellchecker::joinLangs(_currentLangs));
 }
@@ -1,7 +1,10 @@
 #ifndef SPELL_CHECKER_H
 #define SPELL_CHECKER_H
 
+#include <QCache>
+#include <QMutex>
 #include <QObject>
+#include <QStringList>
 
 QT_BEGIN_NAMESPACE
 class QAction;
@@ -12,6 +15,13 @@ QT_END_NAMESPACE
 
 class Hunspell;
 
+struct SpellcheckCacheStats
+{
+    qint64 hits = 0;
+    qint64 misses = 0;
+    int size = 0;
+};
+
 class Spellchecker : public QObject
 {
     Q_OBJECT
@@ -19,13 +29,33 @@ class Spellchecker : public QObject
 public:
     static Spellchecker* get(const QString& lang);
 
+    /// Returns spellcheckers for dictionaries opened since program start.
+    static QList<Spellchecker*> loaded();
+
+    /// A memo can be checked against several dictionaries,
+    /// their languages are stored as a comma separated list, the main language goes first.
+    static QStringList splitLangs(const QString& langs);
+    static QString joinLangs(const QStringList& langs);
+
+    /// Returns script of the first letter of the word.
+    static QChar::Script wordScript(const QString& word);
+
     ~Spellchecker();
 
     const QString& lang() const { return _lang; }
+
+    /// Script of words in the dictionary, it's Script_Unknown when it can't be detected.
+    QChar::Script script() const { return _script; }
+
+    /// Returns true when the word should be checked by this dictionary.
+    /// Words in other scripts are left to other dictionaries.
+    bool handles(const QString& word) const;
+
     bool check(const QString &word) const;
     void ignore(const QString &word);
     void save(const QString &word);
     QStringList suggest(const QString &word) const;
+    SpellcheckCacheStats cacheStats() const;
 
 signals:
     void wordIgnored(const QString& word);
@@ -34,10 +64,20 @@ private:
     Spellchecker(const QString &dictFilePath, const QString &affixFilePath, const QString &userDictionaryPath);
 
     QString _lang;
+    QChar::Script _script = QChar::Script_Unknown;
     QString _userDictionaryPath;
     Hunspell* _hunspell = nullptr;
     QTextCodec *_codec;
 
+    // Words are checked in background threads while the dictionary can be changed in GUI thread
+    mutable QMutex _mutex;
+
+    // Verdicts for recently checked words, the same words repeat many times in a text
+    mutable QCache<QString, bool> _cache;
+    mutable SpellcheckCacheStats _cacheStats;
+
+    void clearCache();
+
     void loadUserDictionary();
 };
 
@@ -59,6 +99,7 @@ signals:
 
 private:
     QActionGroup* _actionGroup = nullptr;
+    QStringList _currentLangs;
 
     void actionGroupTriggered(QAction* action);
 };
@@ -1,28 +1,54 @@
 #include "TextEditSpellcheck.h"
 
+#include "SpellcheckBlockData.h"
+#include "SpellcheckEngine.h"
 #include "Spellchecker.h"
-#include "../TextEditHelpers.h"
 
 #include <QAction>
 #include <QDebug>
 #include <QMenu>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextLayout>
 #include <QTimer>
 
 using This = TextEditSpellcheck;
 
-TextEditSpellcheck::TextEditSpellcheck(QTextEdit *editor, Spellchecker *spellchecker, QObject *parent)
-    : QObject(parent), _editor(editor), _spellchecker(spellchecker)
+// Approximate number of characters checked at once in worker thread
+static const int SPELLCHECK_PIECE_SIZE = 8192;
+
+// Scrolling is not stopped at once, it's better to wait a bit before checking what becomes visible
+static const int SCROLL_DELAY_MS = 100;
+
+TextEditSpellcheck::TextEditSpellcheck(QTextEdit *editor, const QList<Spellchecker*>& spellcheckers, QObject *parent)
+    : QObject(parent), _editor(editor), _spellcheckers(spellcheckers)
 {
-    connect(_spellchecker, &Spellchecker::wordIgnored, this, &This::wordIgnored);
+    for (auto spellchecker : _spellcheckers)
+        connect(spellchecker, &Spellchecker::wordIgnored, this, &This::wordIgnored);
 
     _editor->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(_editor, &QTextEdit::customContextMenuRequested, this, &This::contextMenuRequested);
     connect(_editor->document(), QOverload<int, int, int>::of(&QTextDocument::contentsChange), this, &This::documentChanged);
-    connect(_editor, &QTextEdit::cursorPositionChanged, this, &This::cursorMoved);
+    _revision = _editor->document()->revision();
 
     _timer = new QTimer(this);
     _timer->setInterval(500);
     connect(_timer, &QTimer::timeout, this, &This::spellcheckChanges);
+
+    _scrollTimer = new QTimer(this);
+    _scrollTimer->setInterval(SCROLL_DELAY_MS);
+    _scrollTimer->setSingleShot(true);
+    connect(_scrollTimer, &QTimer::timeout, this, &This::spellcheckVisible);
+    connect(_editor->verticalScrollBar(), &QScrollBar::valueChanged, _scrollTimer, QOverload<>::of(&QTimer::start));
+
+    // Zero interval makes the timer fire when there are no other events to process
+    _idleTimer = new QTimer(this);
+    _idleTimer->setInterval(0);
+    _idleTimer->setSingleShot(true);
+    connect(_idleTimer, &QTimer::timeout, this, &This::spellcheckIdle);
+
+    _engine = new SpellcheckEngine(_spellcheckers, this);
+    connect(_engine, &SpellcheckEngine::checked, this, &This::spellchecked);
 }
 
 TextEditSpellcheck::~TextEditSpellcheck()
@@ -35,105 +61,200 @@ TextEditSpellcheck::~TextEditSpellcheck()
 
 void TextEditSpellcheck::spellcheckAll()
 {
-    _spellcheckStart = -1;
-    _spellcheckStop = -1;
-    spellcheck();
-    _editor->setExtraSelections(_errorMarks);
+    // Visible blocks are checked first, so the user gets the result at once even for a huge memo.
+    // Other blocks are checked piece by piece when the editor has nothing else to do.
+    spellcheckVisible();
+    _idleActive = true;
+    scheduleIdle();
+}
+
+void TextEditSpellcheck::spellcheckVisible()
+{
+    // The idle check starts from the viewport, so it begins anew when the user scrolls
+    resetIdle();
+
+    auto viewport = _editor->viewport();
+    int start = _editor->cursorForPosition(QPoint(0, 0)).position();
+    int stop = _editor->cursorForPosition(QPoint(viewport->width(), viewport->height())).position();
+    requestSpellcheck(start, stop);
+}
+
+void TextEditSpellcheck::scheduleIdle()
+{
+    // Only one piece is processed at a time, so the worker is free
+    // to check visible blocks as soon as the user scrolls to them
+    if (_idleActive && _requestsInFlight == 0)
+        _idleTimer->start();
 }
 
-static int selectWord(QTextCursor& cursor)
+void TextEditSpellcheck::spellcheckIdle()
 {
-    // When move cursor to EndOfWord, it stops before bracket, qoute, or punctuation.
-    // But quotes like &raquo; or &rdquo; become a part of the world for some reason.
-    // Remove such punctuation at word boundaries.
+    if (_requestsInFlight > 0) return;
 
-    QString word = cursor.selectedText();
-    int length = word.length();
-    int start = 0;
-    int stop = length - 1;
+    auto doc = _editor->document();
+    int revision = doc->revision();
 
-    while (start < length)
+    // Blocks below the viewport are more likely to be seen next than the beginning of the document.
+    // The scan continues from where the previous piece was found, so clean blocks are passed only once.
+    if (_idleResume < 0)
     {
-        auto ch = word.at(start);
-        if (ch.isLetter() || ch.isDigit()) break;
-        start++;
+        _idleOrigin = _editor->cursorForPosition(QPoint(0, 0)).block().position();
+        _idleResume = _idleOrigin;
+        _idleWrapped = false;
     }
 
-    while (stop > start)
+    auto block = doc->findBlock(_idleResume);
+    if (!_idleWrapped)
     {
-        auto ch = word.at(stop);
-        if (ch.isLetter() || ch.isDigit()) break;
-        stop--;
+        while (block.isValid() && !needsSpellcheck(block, revision))
+            block = block.next();
+        if (!block.isValid())
+        {
+            _idleWrapped = true;
+            block = doc->begin();
+        }
+    }
+    if (_idleWrapped)
+    {
+        while (block.isValid() && block.position() < _idleOrigin && !needsSpellcheck(block, revision))
+            block = block.next();
+        if (!block.isValid() || block.position() >= _idleOrigin)
+        {
+            _idleActive = false;
+            return;
+        }
     }
 
-    length = stop - start + 1;
-    int anchor = cursor.anchor();
-    cursor.setPosition(anchor + start, QTextCursor::MoveAnchor);
-    cursor.setPosition(anchor + start + length, QTextCursor::KeepAnchor);
-    return length;
+    _idleResume = block.position();
+    requestSpellcheck(block.position(), block.position() + SPELLCHECK_PIECE_SIZE);
 }
 
-void TextEditSpellcheck::spellcheck()
+void TextEditSpellcheck::resetIdle()
 {
-    static auto spellErrorFormat = TextFormat().spellError().get();
-
-    _errorMarks.clear();
-
-    QTextCursor cursor(_editor->document());
+    _idleResume = -1;
+}
 
-    if (_spellcheckStart > -1) cursor.setPosition(_spellcheckStart);
+bool TextEditSpellcheck::needsSpellcheck(const QTextBlock& block, int revision)
+{
+    auto data = SpellcheckBlockData::of(block);
+    return !data || (data->dirty && data->requestedRevision != revision);
+}
 
-    while ((_spellcheckStop < 0 || cursor.position() < _spellcheckStop) && !cursor.atEnd())
+void TextEditSpellcheck::requestSpellcheck(int start, int stop)
+{
+    auto doc = _editor->document();
+    int revision = doc->revision();
+
+    // The range is checked by pieces of whole blocks, so results for the beginning
+    // of a big document are shown soon and an edit makes stale only pieces being checked.
+    // Blocks which are clean or already sent for checking are skipped.
+    auto block = doc->findBlock(start);
+    while (block.isValid() && block.position() <= stop)
     {
-        cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-        int length = selectWord(cursor);
-
-        // When we've skipped punctuation and there is no word,
-        // the cursor may be at the beginning of the next word already.
-        // For example, have text "(word1) word2",
-        // the bracket "(" is treated by QTextEdit as a separate word.
-        // After skipping it, we become at the "w" of "word1" - at the next word after the bracket!
-        // Then moving to `NextWord` shifts the cursor to "word2", and "word1" gets missed.
-        // To avoid, try to find the end of a (possible current) word after skipping punctuation.
-        if (length == 0)
+        if (!needsSpellcheck(block, revision))
         {
-            cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-            length = selectWord(cursor);
+            block = block.next();
+            continue;
         }
 
-        // Skip one-letter words
-        //
-        // TODO: currently, abbreviations such as "e.i.", "e.g.", "т.д.", "т.п."
-        // are splitted to series of one-letter words and therefore skipped.
-        // It allows mixing of such words in different languages,
-        // e.g. one can use "т.д." in a text in English, it's not ok.
-        //
-        // Similar issue with words like "doesn't" - it splitted into "doesn" and "t",
-        // "t" is skipped and "doesn" gives spelling error. Checking is ok when
-        // true apostrophe character is used (’ = U+2019). But it's not the case
-        // when one type memos via keyboard - single quote is generally used as apostrophe.
-        //
-        // It'd be better to check such words as a whole.
-        //
-        if (length > 1 && TextEditHelpers::hyperlinkAt(cursor).isEmpty())
+        SpellcheckRequest request;
+        request.revision = revision;
+        request.position = block.position();
+
+        int pieceStop = request.position;
+        while (block.isValid() && block.position() <= stop && needsSpellcheck(block, revision))
         {
-            QString word = cursor.selectedText();
+            auto data = SpellcheckBlockData::of(block);
+            if (!data)
+            {
+                data = new SpellcheckBlockData;
+                data->length = block.length();
+                block.setUserData(data);
+            }
+            data->requestedRevision = revision;
+
+            // Hyperlinks are detected by highlighter, they are not available in worker thread
+            for (auto format : block.layout()->formats())
+                if (format.format.isAnchor() && !format.format.anchorHref().isEmpty())
+                    request.skipped << qMakePair(block.position() + format.start - request.position, format.length);
+
+            // Block separator is not included
+            pieceStop = block.position() + block.length() - 1;
+            block = block.next();
+            if (pieceStop - request.position >= SPELLCHECK_PIECE_SIZE) break;
+        }
+
+        QTextCursor cursor(doc);
+        cursor.setPosition(request.position);
+        cursor.setPosition(pieceStop, QTextCursor::KeepAnchor);
+        request.text = cursor.selectedText();
 
-            if (!_spellchecker->check(word))
-                _errorMarks << QTextEdit::ExtraSelection {cursor, spellErrorFormat};
+        _engine->check(request);
+        _requestsInFlight++;
+    }
+}
+
+void TextEditSpellcheck::spellchecked(const SpellcheckResult& result)
+{
+    _requestsInFlight--;
+
+    if (!_editor) return;
+
+    auto doc = _editor->document();
+
+    // The text has been changed while it was checked, positions of errors can be wrong.
+    // Drop them and check again when the editing stops. Blocks of the result
+    // could be shifted by the editing, so dirty blocks are looked for in the whole document.
+    if (result.revision != doc->revision())
+    {
+        _idleActive = true;
+        _timer->start();
+        return;
+    }
+
+    int stop = result.position + result.length;
+    int errorIndex = 0;
+    for (auto block = doc->findBlock(result.position); block.isValid() && block.position() <= stop; block = block.next())
+    {
+        auto data = SpellcheckBlockData::of(block);
+        if (!data)
+        {
+            data = new SpellcheckBlockData;
+            block.setUserData(data);
         }
 
-        cursor.movePosition(QTextCursor::NextWord, QTextCursor::MoveAnchor);
+        data->errors.clear();
+        int blockStop = block.position() + block.length();
+        while (errorIndex < result.errors.size() && result.errors.at(errorIndex).first < blockStop)
+        {
+            auto& error = result.errors.at(errorIndex++);
+            data->errors << qMakePair(error.first - block.position(), error.second);
+        }
+        data->length = block.length();
+        data->dirty = false;
     }
+
+    _editor->viewport()->update();
+
+    scheduleIdle();
 }
 
 QTextCursor TextEditSpellcheck::spellingAt(const QPoint& pos) const
 {
     auto cursor = _editor->cursorForPosition(_editor->viewport()->mapFromParent(pos));
-    auto cursorPos = cursor.position();
-    for (auto es : _editor->extraSelections())
-        if (cursorPos >= es.cursor.anchor() && cursorPos <= es.cursor.position())
-            return es.cursor;
+    auto block = cursor.block();
+    auto data = SpellcheckBlockData::of(block);
+    if (!data || data->length != block.length()) return QTextCursor();
+
+    auto cursorPos = cursor.positionInBlock();
+    for (auto& error : data->errors)
+        if (cursorPos >= error.first && cursorPos <= error.first + error.second)
+        {
+            QTextCursor errorCursor(block);
+            errorCursor.setPosition(block.position() + error.first);
+            errorCursor.setPosition(block.position() + error.first + error.second, QTextCursor::KeepAnchor);
+            return errorCursor;
+        }
     return QTextCursor();
 }
 
@@ -149,13 +270,28 @@ void TextEditSpellcheck::contextMenuRequested(const QPoint &pos)
     delete menu;
 }
 
+QList<Spellchecker*> TextEditSpellcheck::spellcheckersFor(const QString& word) const
+{
+    QList<Spellchecker*> spellcheckers;
+    for (auto spellchecker : _spellcheckers)
+        if (spellchecker->handles(word))
+            spellcheckers << spellchecker;
+    return spellcheckers;
+}
+
 void TextEditSpellcheck::addSpellcheckActions(QMenu* menu, QTextCursor& cursor)
 {
     auto word = cursor.selectedText();
+    auto spellcheckers = spellcheckersFor(word);
 
     QList<QAction*> actions;
 
-    auto variants = _spellchecker->suggest(word);
+    // There can be several dictionaries for the script of the word
+    QStringList variants;
+    for (auto spellchecker : spellcheckers)
+        for (auto variant : spellchecker->suggest(word))
+            if (!variants.contains(variant))
+                variants << variant;
     if (variants.isEmpty())
     {
         auto actionNone = new QAction(tr("No variants"), menu);
@@ -175,15 +311,19 @@ void TextEditSpellcheck::addSpellcheckActions(QMenu* menu, QTextCursor& cursor)
         }
 
     auto actionRemember = new QAction(tr("Add to dictionary"), menu);
-    connect(actionRemember, &QAction::triggered, [this, cursor, word]{
-        _spellchecker->save(word);
-        _spellchecker->ignore(word);
+    connect(actionRemember, &QAction::triggered, [spellcheckers, word]{
+        for (auto spellchecker : spellcheckers)
+        {
+            spellchecker->save(word);
+            spellchecker->ignore(word);
+        }
     });
     actions << actionRemember;
 
     auto actionIgnore = new QAction(tr("Ignore this world"), menu);
-    connect(actionIgnore, &QAction::triggered, [this, cursor, word]{
-        _spellchecker->ignore(word);
+    connect(actionIgnore, &QAction::triggered, [spellcheckers, word]{
+        for (auto spellchecker : spellcheckers)
+            spellchecker->ignore(word);
     });
     actions << actionIgnore;
 
@@ -196,21 +336,75 @@ void TextEditSpellcheck::addSpellcheckActions(QMenu* menu, QTextCursor& cursor)
 
 void TextEditSpellcheck::removeErrorMark(const QTextCursor& cursor)
 {
-    QList<QTextEdit::ExtraSelection> marks;
-    for (auto mark : _editor->extraSelections())
-        if (mark.cursor != cursor)
-            marks << mark;
-    _editor->setExtraSelections(marks);
+    auto block = cursor.block();
+    auto data = SpellcheckBlockData::of(block);
+    if (!data) return;
+
+    auto error = qMakePair(cursor.selectionStart() - block.position(), cursor.selectionEnd() - cursor.selectionStart());
+    if (data->errors.removeAll(error) > 0)
+        _editor->viewport()->update();
 }
 
 void TextEditSpellcheck::clearErrorMarks()
 {
-    _editor->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    auto doc = _editor->document();
+    for (auto block = doc->begin(); block != doc->end(); block = block.next())
+        if (SpellcheckBlockData::of(block))
+            block.setUserData(nullptr);
+    _editor->viewport()->update();
 }
 
 void TextEditSpellcheck::documentChanged(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(charsRemoved)
+    auto doc = _editor->document();
+
+    // Highlighter reports about changed formatting as about changed text
+    if (charsRemoved == charsAdded && doc->revision() == _revision) return;
+    _revision = doc->revision();
+
+    // Positions of the idle check are not valid anymore
+    resetIdle();
+
+    auto block = doc->findBlock(position);
+    auto lastBlock = doc->findBlock(position + charsAdded);
+    if (block == lastBlock)
+    {
+        auto data = SpellcheckBlockData::of(block);
+        if (data)
+        {
+            // Errors are kept until the block is rechecked, only ones touched by the change are removed
+            int delta = charsAdded - charsRemoved;
+            if (data->length + delta == block.length())
+            {
+                int changeStart = position - block.position();
+                int changeStop = changeStart + charsRemoved;
+                QVector<QPair<int, int>> errors;
+                for (auto& error : data->errors)
+                    if (error.first + error.second < changeStart)
+                        errors << error;
+                    else if (error.first > changeStop)
+                        errors << qMakePair(error.first + delta, error.second);
+                data->errors = errors;
+            }
+            // Another block has been merged into this one
+            else data->errors.clear();
+
+            data->length = block.length();
+            data->dirty = data->dirty || !_changesLocked;
+        }
+    }
+    else
+    {
+        // Blocks have been split or inserted, positions of errors in them are unknown
+        for (; block.isValid() && block.position() <= lastBlock.position(); block = block.next())
+        {
+            auto data = SpellcheckBlockData::of(block);
+            if (!data) continue;
+            data->errors.clear();
+            data->length = block.length();
+            data->dirty = true;
+        }
+    }
 
     if (_changesLocked) return;
 
@@ -219,8 +413,6 @@ void TextEditSpellcheck::documentChanged(int position, int charsRemoved, int cha
     int stopPos = position + charsAdded;
     if (stopPos > _changesStop) _changesStop = stopPos;
 
-    _isHrefChanged = _isHrefChanged || !_hyperlinkAtCursor.isEmpty();
-
     _timer->start();
 }
 
@@ -228,49 +420,35 @@ void TextEditSpellcheck::spellcheckChanges()
 {
     _timer->stop();
 
-    QTextCursor cursor(_editor->document());
-
-    // We could insert spaces and split a word in two.
-    // Then we have to check not only the current word but also the previous one.
-    // That's the reason for shifting to -1 from _changesStart position.
-    // But if there is/was a hyperlink in place of changes,
-    // it can contain arbitrary number of words, then it better to check all the block.
-    cursor.setPosition(_changesStart > 0 ? _changesStart - 1 : _changesStart);
-    cursor.movePosition(_isHrefChanged ? QTextCursor::StartOfBlock : QTextCursor::StartOfWord, QTextCursor::MoveAnchor);
-    _spellcheckStart = cursor.position();
-
-    cursor.setPosition(_changesStop);
-    cursor.movePosition(_isHrefChanged ? QTextCursor::EndOfBlock : QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-    _spellcheckStop = cursor.position();
-
-    // Remove marks which are in checking range, they will be recreated on spellcheck
-    QList<QTextEdit::ExtraSelection> errorMarks;
-    for (auto es : _editor->extraSelections())
-        if (es.cursor.position() < _spellcheckStart ||
-            es.cursor.anchor() >= _spellcheckStop)
-            errorMarks << es;
-
-    spellcheck();
-
-    errorMarks.append(_errorMarks);
-    _editor->setExtraSelections(errorMarks);
-
-    _spellcheckStart = -1;
-    _spellcheckStop = -1;
-    _changesStart = -1;
-    _changesStop = -1;
-}
+    // Only changed blocks are checked, they are marked as dirty.
+    // Changed range could be stored before the text was shortened.
+    // There are no changes when the timer was started by a stale result.
+    if (_changesStart >= 0)
+    {
+        int start = qMin(_changesStart, _editor->document()->characterCount() - 1);
+        int stop = _changesStop;
+        _changesStart = -1;
+        _changesStop = -1;
+        requestSpellcheck(start, stop);
+    }
 
-void TextEditSpellcheck::cursorMoved()
-{
-    _hyperlinkAtCursor = TextEditHelpers::hyperlinkAt(_editor->textCursor());
+    scheduleIdle();
 }
 
 void TextEditSpellcheck::wordIgnored(const QString& word)
 {
-    QList<QTextEdit::ExtraSelection> errorMarks;
-    for (auto es : _editor->extraSelections())
-        if (es.cursor.selectedText() != word)
-            errorMarks << es;
-    _editor->setExtraSelections(errorMarks);
+    auto doc = _editor->document();
+    for (auto block = doc->begin(); block != doc->end(); block = block.next())
+    {
+        auto data = SpellcheckBlockData::of(block);
+        if (!data || data->errors.isEmpty()) continue;
+
+        QString text = block.text();
+        QVector<QPair<int, int>> errors;
+        for (auto& error : data->errors)
+            if (text.mid(error.first, error.second) != word)
+                errors << error;
+        data->errors = errors;
+    }
+    _editor->viewport()->update();
 }
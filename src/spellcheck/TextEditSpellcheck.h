@@ -4,10 +4,13 @@
 #include <QPointer>
 #include <QTextEdit>
 
+class SpellcheckEngine;
 class Spellchecker;
+struct SpellcheckResult;
 
 QT_BEGIN_NAMESPACE
 class QAction;
+class QTextBlock;
 class QTimer;
 QT_END_NAMESPACE
 
@@ -16,33 +19,43 @@ class TextEditSpellcheck : public QObject
     Q_OBJECT
 
 public:
-    explicit TextEditSpellcheck(QTextEdit* editor, Spellchecker* spellchecker, QObject *parent = nullptr);
+    explicit TextEditSpellcheck(QTextEdit* editor, const QList<Spellchecker*>& spellcheckers, QObject *parent = nullptr);
     ~TextEditSpellcheck();
     void clearErrorMarks();
     void spellcheckAll();
 
 private:
     QPointer<QTextEdit> _editor;
-    Spellchecker* _spellchecker = nullptr;
+    QList<Spellchecker*> _spellcheckers;
+    SpellcheckEngine* _engine = nullptr;
     QTimer* _timer = nullptr;
+    QTimer* _scrollTimer = nullptr;
+    QTimer* _idleTimer = nullptr;
+    bool _idleActive = false;
+    int _idleOrigin = -1;
+    int _idleResume = -1;
+    bool _idleWrapped = false;
+    int _requestsInFlight = 0;
     int _changesStart = -1;
     int _changesStop = -1;
-    bool _isHrefChanged = false;
-    int _spellcheckStart = -1;
-    int _spellcheckStop = -1;
-    QList<QTextEdit::ExtraSelection> _errorMarks;
+    int _revision = 0;
     bool _changesLocked = false;
-    QString _hyperlinkAtCursor;
 
-    void spellcheck();
+    void spellcheckVisible();
+    void scheduleIdle();
+    void spellcheckIdle();
+    void resetIdle();
+    static bool needsSpellcheck(const QTextBlock& block, int revision);
+    void requestSpellcheck(int start, int stop);
+    void spellchecked(const SpellcheckResult& result);
     QTextCursor spellingAt(const QPoint& pos) const;
     void contextMenuRequested(const QPoint &pos);
+    QList<Spellchecker*> spellcheckersFor(const QString& word) const;
     void addSpellcheckActions(QMenu* menu, QTextCursor &cursor);
     void removeErrorMark(const QTextCursor& cursor);
     void documentChanged(int position, int charsRemoved, int charsAdded);
     void spellcheckChanges();
     void wordIgnored(const QString& word);
-    void cursorMoved();
 };
 
 #endif // TEXT_EDIT_SPELLCHECK_H
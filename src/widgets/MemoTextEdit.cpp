@@ -1,11 +1,13 @@
 #include "MemoTextEdit.h"
 
 #include "../TextEditHelpers.h"
+#include "../spellcheck/SpellcheckBlockData.h"
 
 #include <QDebug>
 #include <QDesktopServices>
 #include <QMenu>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <QTextBlock>
 #include <QTimer>
 #include <QToolTip>
@@ -68,6 +70,13 @@ bool MemoTextEdit::event(QEvent *event)
     return true;
 }
 
+void MemoTextEdit::paintEvent(QPaintEvent *e)
+{
+    QTextEdit::paintEvent(e);
+
+    SpellcheckBlockData::paintErrors(this, e->rect());
+}
+
 bool MemoTextEdit::wordWrap() const
 {
     return wordWrapMode() != QTextOption::NoWrap;
@@ -17,6 +17,7 @@ protected:
     void mousePressEvent(QMouseEvent *e) override;
     void mouseReleaseEvent(QMouseEvent *e) override;
     bool event(QEvent *event) override;
+    void paintEvent(QPaintEvent *e) override;
 
 private:
     QString _clickedHref;